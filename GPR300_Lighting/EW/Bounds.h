@@ -0,0 +1,27 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace ew {
+	/// <summary>
+	/// Axis aligned bounding box
+	/// </summary>
+	struct AABB {
+		glm::vec3 min = glm::vec3(0);
+		glm::vec3 max = glm::vec3(0);
+	};
+
+	//Bounds of box after being transformed by m (Arvo's method)
+	inline AABB transformAABB(const AABB& box, const glm::mat4& m) {
+		AABB out;
+		out.min = out.max = glm::vec3(m[3]);
+		for (int col = 0; col < 3; col++) {
+			for (int row = 0; row < 3; row++) {
+				float a = m[col][row] * box.min[col];
+				float b = m[col][row] * box.max[col];
+				out.min[row] += glm::min(a, b);
+				out.max[row] += glm::max(a, b);
+			}
+		}
+		return out;
+	}
+}
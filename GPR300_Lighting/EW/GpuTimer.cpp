@@ -0,0 +1,36 @@
+#include "GpuTimer.h"
+
+namespace ew {
+	GpuTimer::GpuTimer()
+		: mCurrent(0), mMilliseconds(0.0f)
+	{
+		glGenQueries(NUM_QUERIES, mQueries);
+		for (int i = 0; i < NUM_QUERIES; i++)
+			mPending[i] = false;
+	}
+
+	GpuTimer::~GpuTimer()
+	{
+		glDeleteQueries(NUM_QUERIES, mQueries);
+	}
+
+	void GpuTimer::begin()
+	{
+		//Collect the result this query held NUM_QUERIES frames ago before reusing it
+		if (mPending[mCurrent]) {
+			GLuint64 elapsed;
+			glGetQueryObjectui64v(mQueries[mCurrent], GL_QUERY_RESULT, &elapsed);
+			float ms = (float)(elapsed / 1000000.0);
+			mMilliseconds += (ms - mMilliseconds) * 0.1f;
+			mPending[mCurrent] = false;
+		}
+		glBeginQuery(GL_TIME_ELAPSED, mQueries[mCurrent]);
+	}
+
+	void GpuTimer::end()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		mPending[mCurrent] = true;
+		mCurrent = (mCurrent + 1) % NUM_QUERIES;
+	}
+}
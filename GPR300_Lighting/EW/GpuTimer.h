@@ -0,0 +1,25 @@
+#pragma once
+#include <GL/glew.h>
+
+namespace ew {
+	/// <summary>
+	/// Measures GPU time between begin() and end() with timer queries.
+	/// Results are read a few frames late so the CPU never waits on the GPU.
+	/// </summary>
+	class GpuTimer {
+	public:
+		GpuTimer();
+		~GpuTimer();
+		void begin();
+		void end();
+		//Smoothed time in milliseconds
+		inline float getMilliseconds()const { return mMilliseconds; }
+	private:
+		GpuTimer(const GpuTimer& r) = delete;
+		static const int NUM_QUERIES = 4;
+		GLuint mQueries[NUM_QUERIES];
+		bool mPending[NUM_QUERIES];
+		int mCurrent;
+		float mMilliseconds;
+	};
+}
@@ -31,8 +31,34 @@ namespace ew {
 		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, tangent)));
 		glEnableVertexAttribArray(3);
 
+		//Tightly packed positions sharing the same index buffer, bound to location 0 like aPos
+		std::vector<glm::vec3> positions;
+		positions.reserve(meshData->vertices.size());
+		for (const Vertex& v : meshData->vertices)
+			positions.push_back(v.position);
+
+		glGenVertexArrays(1, &mDepthVAO);
+		glBindVertexArray(mDepthVAO);
+
+		glGenBuffers(1, &mPositionVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, mPositionVBO);
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (const void*)0);
+		glEnableVertexAttribArray(0);
+
+		glBindVertexArray(0);
+
 		mNumIndices = (GLsizei)meshData->indices.size();
 		mNumVertices = (GLsizei)meshData->vertices.size();
+
+		//Local space bounds, used for culling
+		mBounds.min = mBounds.max = meshData->vertices[0].position;
+		for (const Vertex& v : meshData->vertices) {
+			mBounds.min = glm::min(mBounds.min, v.position);
+			mBounds.max = glm::max(mBounds.max, v.position);
+		}
 	}
 
 	Mesh::~Mesh()
@@ -40,6 +66,8 @@ namespace ew {
 		glDeleteVertexArrays(1, &mVAO);
 		glDeleteBuffers(1, &mVBO);
 		glDeleteBuffers(1, &mEBO);
+		glDeleteVertexArrays(1, &mDepthVAO);
+		glDeleteBuffers(1, &mPositionVBO);
 	}
 
 	void Mesh::draw()
@@ -48,4 +76,22 @@ namespace ew {
 		glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
 	}
 
+	void Mesh::drawInstanced(GLsizei instanceCount, GLuint baseInstance)
+	{
+		glBindVertexArray(mVAO);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0, instanceCount, baseInstance);
+	}
+
+	void Mesh::drawDepth()
+	{
+		glBindVertexArray(mDepthVAO);
+		glDrawElements(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0);
+	}
+
+	void Mesh::drawDepthInstanced(GLsizei instanceCount, GLuint baseInstance)
+	{
+		glBindVertexArray(mDepthVAO);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, mNumIndices, GL_UNSIGNED_INT, 0, instanceCount, baseInstance);
+	}
+
 }
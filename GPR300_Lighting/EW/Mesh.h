@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include "Bounds.h"
 
 namespace ew {
 	struct Vertex {
@@ -32,9 +33,21 @@ namespace ew {
 		void Load(MeshData* meshData);
 		~Mesh();
 		void draw();
+		//baseInstance offsets the per instance attributes, see InstanceBatches
+		void drawInstanced(GLsizei instanceCount, GLuint baseInstance = 0);
+		//Position only versions for shadow and depth passes, read 12 bytes a vertex instead of 44
+		void drawDepth();
+		void drawDepthInstanced(GLsizei instanceCount, GLuint baseInstance = 0);
+		//For attaching per instance attributes
+		inline GLuint getVertexArray()const { return mVAO; }
+		inline GLuint getDepthVertexArray()const { return mDepthVAO; }
+		inline const AABB& getBounds()const { return mBounds; }
+		inline GLsizei getNumIndices()const { return mNumIndices; }
 	private:
 		GLuint mVAO, mVBO, mEBO;
+		GLuint mDepthVAO, mPositionVBO;
 		GLsizei mNumIndices;
 		GLsizei mNumVertices;
+		AABB mBounds;
 	};
 }
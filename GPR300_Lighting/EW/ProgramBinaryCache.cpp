@@ -0,0 +1,150 @@
+#include "ProgramBinaryCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace ew {
+	static std::string sFolder = "shaderCache";
+	static bool sFolderCreated = false;
+	static int sNumBinaryFormats = -1;	//Queried on first use, needs a context
+	static ProgramBinaryCache::Stats sStats = {};
+
+	//Written before the binary, the key guards against a file renamed by hand
+	struct BinaryHeader {
+		char magic[4];
+		unsigned long long key;
+		GLenum format;
+		GLint length;
+	};
+	static const char BINARY_MAGIC[4] = { 'P', 'B', 'I', 'N' };
+
+	static void hashBytes(unsigned long long& hash, const void* data, size_t length)
+	{
+		//FNV-1a
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < length; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	}
+
+	void ProgramBinaryCache::setFolder(const std::string& folder)
+	{
+		sFolder = folder;
+		sFolderCreated = false;
+	}
+
+	bool ProgramBinaryCache::isEnabled()
+	{
+		if (sNumBinaryFormats < 0)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &sNumBinaryFormats);
+		return !sFolder.empty() && sNumBinaryFormats > 0;
+	}
+
+	unsigned long long ProgramBinaryCache::hashSources(const std::string sources[], const GLenum types[], int numSources)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		const GLenum driverStrings[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+		for (int i = 0; i < 3; i++) {
+			const char* driverString = (const char*)glGetString(driverStrings[i]);
+			if (driverString)
+				hashBytes(hash, driverString, strlen(driverString));
+		}
+		for (int i = 0; i < numSources; i++) {
+			hashBytes(hash, &types[i], sizeof(GLenum));
+			hashBytes(hash, sources[i].data(), sources[i].size());
+		}
+		return hash;
+	}
+
+	std::string ProgramBinaryCache::getPath(unsigned long long key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", key);
+		return sFolder + "/" + name;
+	}
+
+	bool ProgramBinaryCache::load(unsigned long long key, GLuint program)
+	{
+		if (!isEnabled())
+			return false;
+		FILE* file = fopen(getPath(key).c_str(), "rb");
+		if (!file)
+			return false;
+		BinaryHeader header;
+		std::vector<char> binary;
+		bool valid = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, BINARY_MAGIC, 4) == 0
+			&& header.key == key && header.length > 0;
+		if (valid) {
+			binary.resize(header.length);
+			valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+		}
+		fclose(file);
+		if (!valid)
+			return false;
+
+		//Drivers may refuse binaries from another build even with the same version string
+		glProgramBinary(program, header.format, binary.data(), header.length);
+		GLint success = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			sStats.rejected++;
+			return false;
+		}
+		return true;
+	}
+
+	void ProgramBinaryCache::save(unsigned long long key, GLuint program)
+	{
+		if (!isEnabled())
+			return;
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return;
+		std::vector<char> binary(length);
+		BinaryHeader header;
+		memcpy(header.magic, BINARY_MAGIC, 4);
+		header.key = key;
+		glGetProgramBinary(program, length, &header.length, &header.format, binary.data());
+
+		if (!sFolderCreated) {
+#ifdef _WIN32
+			_mkdir(sFolder.c_str());
+#else
+			mkdir(sFolder.c_str(), 0755);
+#endif
+			sFolderCreated = true;
+		}
+		FILE* file = fopen(getPath(key).c_str(), "wb");
+		if (!file) {
+			printf("Failed to write program binary %s\n", getPath(key).c_str());
+			return;
+		}
+		fwrite(&header, sizeof(header), 1, file);
+		fwrite(binary.data(), 1, header.length, file);
+		fclose(file);
+	}
+
+	void ProgramBinaryCache::recordHit(double milliseconds)
+	{
+		sStats.hits++;
+		sStats.hitMilliseconds += milliseconds;
+	}
+
+	void ProgramBinaryCache::recordMiss(double milliseconds)
+	{
+		sStats.misses++;
+		sStats.missMilliseconds += milliseconds;
+	}
+
+	const ProgramBinaryCache::Stats& ProgramBinaryCache::getStats()
+	{
+		return sStats;
+	}
+}
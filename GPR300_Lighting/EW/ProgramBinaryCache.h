@@ -0,0 +1,38 @@
+#pragma once
+#include <GL/glew.h>
+#include <string>
+
+namespace ew {
+	/// <summary>
+	/// Linked program binaries saved to disk, one file per program, named after a hash of every stage's source
+	/// (defines and includes already expanded) and the driver's vendor, renderer and version strings.
+	/// A driver update or any shader edit changes the hash, so stale files are never loaded, only left behind.
+	/// </summary>
+	class ProgramBinaryCache {
+	public:
+		//Stats since startup, times include reading/writing the file
+		struct Stats {
+			int hits;
+			int misses;
+			int rejected;	//Found on disk but refused by glProgramBinary, counted as misses too
+			double hitMilliseconds;
+			double missMilliseconds;
+		};
+
+		//Folder the binaries go in, created on the first save. Empty turns the cache off
+		static void setFolder(const std::string& folder);
+		//Hash of the sources, each given with its stage's type, and the driver strings
+		static unsigned long long hashSources(const std::string sources[], const GLenum types[], int numSources);
+		//Loads the binary into program and checks it linked. False if there is none or the driver rejected it,
+		//the program then has to be built from source (in a new program object)
+		static bool load(unsigned long long key, GLuint program);
+		//Saves a linked program that was given GL_PROGRAM_BINARY_RETRIEVABLE_HINT before linking
+		static void save(unsigned long long key, GLuint program);
+		static bool isEnabled();
+		static void recordHit(double milliseconds);
+		static void recordMiss(double milliseconds);
+		static const Stats& getStats();
+	private:
+		static std::string getPath(unsigned long long key);
+	};
+}
@@ -0,0 +1,33 @@
+#include "SampleCounter.h"
+
+namespace ew {
+	SampleCounter::SampleCounter()
+		: mCurrent(0), mSamples(0)
+	{
+		glGenQueries(NUM_QUERIES, mQueries);
+		for (int i = 0; i < NUM_QUERIES; i++)
+			mPending[i] = false;
+	}
+
+	SampleCounter::~SampleCounter()
+	{
+		glDeleteQueries(NUM_QUERIES, mQueries);
+	}
+
+	void SampleCounter::begin()
+	{
+		//Collect the result this query held NUM_QUERIES frames ago before reusing it
+		if (mPending[mCurrent]) {
+			glGetQueryObjectui64v(mQueries[mCurrent], GL_QUERY_RESULT, &mSamples);
+			mPending[mCurrent] = false;
+		}
+		glBeginQuery(GL_SAMPLES_PASSED, mQueries[mCurrent]);
+	}
+
+	void SampleCounter::end()
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		mPending[mCurrent] = true;
+		mCurrent = (mCurrent + 1) % NUM_QUERIES;
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <GL/glew.h>
+
+namespace ew {
+	/// <summary>
+	/// Counts the samples that pass the depth test between begin() and end() with occlusion queries.
+	/// Like GpuTimer, results are read a few frames late so the CPU never waits on the GPU.
+	/// </summary>
+	class SampleCounter {
+	public:
+		SampleCounter();
+		~SampleCounter();
+		void begin();
+		void end();
+		//Most recent result available
+		inline GLuint64 getSamples()const { return mSamples; }
+	private:
+		SampleCounter(const SampleCounter& r) = delete;
+		static const int NUM_QUERIES = 4;
+		GLuint mQueries[NUM_QUERIES];
+		bool mPending[NUM_QUERIES];
+		int mCurrent;
+		GLuint64 mSamples;
+	};
+}
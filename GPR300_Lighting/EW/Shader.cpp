@@ -1,8 +1,10 @@
 //Author: Eric Winebrenner
 
 #include "Shader.h"
+#include "ProgramBinaryCache.h"
 #include <fstream>
 #include <sstream>
+#include <chrono>
 
 #include <glm/vec3.hpp> // glm::vec3
 #include <glm/vec4.hpp> // glm::vec4
@@ -12,18 +14,66 @@
 
 Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath)
 {
-	std::string vertexShaderString = readFile(vertexShaderPath);
-	GLuint vertexShader = compileShader(vertexShaderString.c_str(), GL_VERTEX_SHADER);
+	std::string paths[2] = { vertexShaderPath, fragmentShaderPath };
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	createProgram(paths, types, 2, "");
+}
+
+Shader::Shader(std::string vertexShaderPath, std::string geometryShaderPath, std::string fragmentShaderPath, const std::string& defines) {
+	std::string paths[3] = { vertexShaderPath, geometryShaderPath, fragmentShaderPath };
+	GLenum types[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+	createProgram(paths, types, 3, defines);
+}
+
+Shader::Shader(std::string computeShaderPath)
+{
+	GLenum type = GL_COMPUTE_SHADER;
+	createProgram(&computeShaderPath, &type, 1, "");
+}
 
-	std::string fragmentShaderString = readFile(fragmentShaderPath);
-	GLuint fragmentShader = compileShader(fragmentShaderString.c_str(), GL_FRAGMENT_SHADER);
+void Shader::createProgram(const std::string paths[], const GLenum types[], int numStages, const std::string& defines)
+{
+	auto start = std::chrono::steady_clock::now();
+	std::string sources[3];
+	GLenum stageTypes[3];
+	int numSources = 0;
+	for (int i = 0; i < numStages; i++) {
+		//Empty path = stage not used, e.g. depth only programs with no fragment shader
+		if (paths[i].empty())
+			continue;
+		m_name += (m_name.empty() ? "" : " + ") + paths[i];
+		std::string shaderString = readFile(paths[i]);
+		//#version has to come before anything else but comments, the defines go right after it
+		if (!defines.empty()) {
+			size_t versionEnd = shaderString.find('\n', shaderString.find("#version")) + 1;
+			shaderString.insert(versionEnd, defines);
+		}
+		sources[numSources] = shaderString;
+		stageTypes[numSources++] = types[i];
+	}
+
+	//A binary saved by an earlier run skips compiling and linking
+	unsigned long long key = ew::ProgramBinaryCache::hashSources(sources, stageTypes, numSources);
+	m_id = glCreateProgram();
+	if (ew::ProgramBinaryCache::load(key, m_id)) {
+		ew::ProgramBinaryCache::recordHit(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		reflect();
+		return;
+	}
+	//A rejected binary can leave the program in any state, start over with a new one
+	glDeleteProgram(m_id);
+
+	GLuint shaders[3];
+	for (int i = 0; i < numSources; i++)
+		shaders[i] = compileShader(sources[i].c_str(), stageTypes[i]);
 
 	//Create an empty shader program
 	m_id = glCreateProgram();
+	glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
 	//Attach our shader objects
-	glAttachShader(m_id, vertexShader);
-	glAttachShader(m_id, fragmentShader);
+	for (int i = 0; i < numSources; i++)
+		glAttachShader(m_id, shaders[i]);
 
 	//Link program - will create an executable program with the attached shaders
 	glLinkProgram(m_id);
@@ -37,45 +87,118 @@ Shader::Shader(std::string vertexShaderPath, std::string fragmentShaderPath)
 		glGetProgramInfoLog(m_id, 512, NULL, infoLog);
 		printf("Failed to link shader program: %s", infoLog);
 	}
+	else {
+		ew::ProgramBinaryCache::save(key, m_id);
+	}
+
+	for (int i = 0; i < numSources; i++)
+		glDeleteShader(shaders[i]);
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	ew::ProgramBinaryCache::recordMiss(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	reflect();
 }
 
-Shader::Shader(std::string vertexShaderPath, std::string geometryShaderPath, std::string fragmentShaderPath) {
-	std::string vertexShaderString = readFile(vertexShaderPath);
-	GLuint vertexShader = compileShader(vertexShaderString.c_str(), GL_VERTEX_SHADER);
+//FNV-1a, names are only hashed to look them up, never stored
+static unsigned long long hashName(const char* name, size_t length)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
 
-	std::string geometryShaderString = readFile(geometryShaderPath);
-	GLuint geometryShader = compileShader(geometryShaderString.c_str(), GL_GEOMETRY_SHADER);
+void Shader::reflect()
+{
+	m_uniforms.clear();
+	m_blocks.clear();
+	m_attributes.clear();
+	m_locations.clear();
+	m_inactiveSets.clear();
+	char name[256];
+	GLsizei length = 0;
 
-	std::string fragmentShaderString = readFile(fragmentShaderPath);
-	GLuint fragmentShader = compileShader(fragmentShaderString.c_str(), GL_FRAGMENT_SHADER);
+	GLint numUniforms = 0;
+	glGetProgramInterfaceiv(m_id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms);
+	const GLenum uniformProperties[3] = { GL_LOCATION, GL_ARRAY_SIZE, GL_TYPE };
+	for (GLint i = 0; i < numUniforms; i++) {
+		GLint values[3];
+		glGetProgramResourceiv(m_id, GL_UNIFORM, i, 3, uniformProperties, 3, NULL, values);
+		//Uniform block members have no location, they are reported with their block
+		if (values[0] < 0)
+			continue;
+		glGetProgramResourceName(m_id, GL_UNIFORM, i, sizeof(name), &length, name);
+		int index = (int)m_uniforms.size();
+		m_uniforms.push_back({ std::string(name, length), (GLenum)values[2], values[0], values[1], false });
+		m_locations[hashName(name, length)] = { values[0], index };
 
-	//Create an empty shader program
-	m_id = glCreateProgram();
+		//Arrays are reported as "name[0]", every element is looked up on its own
+		const std::string& fullName = m_uniforms.back().name;
+		size_t bracket = fullName.rfind("[0]");
+		if (bracket == std::string::npos || bracket + 3 != fullName.size())
+			continue;
+		std::string baseName = fullName.substr(0, bracket);
+		m_locations[hashName(baseName.c_str(), baseName.size())] = { values[0], index };
+		for (GLint element = 1; element < values[1]; element++) {
+			std::string elementName = baseName + "[" + std::to_string(element) + "]";
+			m_locations[hashName(elementName.c_str(), elementName.size())] = { glGetUniformLocation(m_id, elementName.c_str()), index };
+		}
+	}
 
-	//Attach our shader objects
-	glAttachShader(m_id, vertexShader);
-	glAttachShader(m_id, geometryShader);
-	glAttachShader(m_id, fragmentShader);
+	GLint numBlocks = 0;
+	glGetProgramInterfaceiv(m_id, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &numBlocks);
+	const GLenum blockProperties[2] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+	for (GLint i = 0; i < numBlocks; i++) {
+		GLint values[2];
+		glGetProgramResourceiv(m_id, GL_UNIFORM_BLOCK, i, 2, blockProperties, 2, NULL, values);
+		glGetProgramResourceName(m_id, GL_UNIFORM_BLOCK, i, sizeof(name), &length, name);
+		m_blocks.push_back({ std::string(name, length), values[0], values[1] });
+	}
 
-	//Link program - will create an executable program with the attached shaders
-	glLinkProgram(m_id);
+	GLint numInputs = 0;
+	glGetProgramInterfaceiv(m_id, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &numInputs);
+	const GLenum inputProperties[2] = { GL_LOCATION, GL_TYPE };
+	for (GLint i = 0; i < numInputs; i++) {
+		GLint values[2];
+		glGetProgramResourceiv(m_id, GL_PROGRAM_INPUT, i, 2, inputProperties, 2, NULL, values);
+		glGetProgramResourceName(m_id, GL_PROGRAM_INPUT, i, sizeof(name), &length, name);
+		m_attributes.push_back({ std::string(name, length), (GLenum)values[1], values[0] });
+	}
+}
 
-	//Logging
-	int success;
-	glGetProgramiv(m_id, GL_LINK_STATUS, &success);
-	if (!success) {
+GLint Shader::getLocation(const std::string& name)const
+{
+	auto it = m_locations.find(hashName(name.c_str(), name.size()));
+	return it != m_locations.end() ? it->second.location : -1;
+}
 
-		GLchar infoLog[512];
-		glGetProgramInfoLog(m_id, 512, NULL, infoLog);
-		printf("Failed to link shader program: %s", infoLog);
+GLint Shader::findLocation(const std::string& name)
+{
+	unsigned long long hash = hashName(name.c_str(), name.size());
+	auto it = m_locations.find(hash);
+	if (it == m_locations.end()) {
+		if (m_inactiveSets.find(hash) == m_inactiveSets.end())
+			m_inactiveSets[hash] = name;
+		return -1;
 	}
+	m_uniforms[it->second.uniform].wasSet = true;
+	return it->second.location;
+}
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(geometryShader);
-	glDeleteShader(fragmentShader);
+void Shader::printReport()const
+{
+	printf("Shader %s: %d uniforms, %d blocks, %d attributes\n", m_name.c_str(), (int)m_uniforms.size(), (int)m_blocks.size(), (int)m_attributes.size());
+	for (const BlockInfo& block : m_blocks)
+		printf("  block %s: binding %d, %d bytes\n", block.name.c_str(), block.binding, block.dataSize);
+	for (const AttributeInfo& attribute : m_attributes)
+		printf("  attribute %s: location %d, type 0x%X\n", attribute.name.c_str(), attribute.location, attribute.type);
+	for (const auto& inactive : m_inactiveSets)
+		printf("  set but not active: %s\n", inactive.second.c_str());
+	for (const UniformInfo& uniform : m_uniforms) {
+		if (!uniform.wasSet)
+			printf("  active but never set: %s (type 0x%X, location %d)\n", uniform.name.c_str(), uniform.type, uniform.location);
+	}
 }
 
 void Shader::use()
@@ -83,31 +206,98 @@ void Shader::use()
 	glUseProgram(m_id);
 }
 
-void Shader::setFloat(std::string name, float value)
+void Shader::setFloat(const std::string& name, float value)
 {
-	glProgramUniform1f(m_id, glGetUniformLocation(m_id, name.c_str()), value);
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform1f(m_id, location, value);
 }
 
-void Shader::setInt(std::string name, int value)
+void Shader::setFloatArray(const std::string& name, const float* values, int count)
 {
-	glProgramUniform1i(m_id, glGetUniformLocation(m_id, name.c_str()), value);
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform1fv(m_id, location, count, values);
 }
 
-void Shader::setMat4(std::string name, const glm::mat4& value) { 
-	glProgramUniformMatrix4fv(m_id, glGetUniformLocation(m_id, name.c_str()), 1, false, glm::value_ptr(value));
+void Shader::setInt(const std::string& name, int value)
+{
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform1i(m_id, location, value);
 }
 
-void Shader::setVec3(std::string name, const glm::vec3& value)
+void Shader::setIntArray(const std::string& name, const int* values, int count)
 {
-	glProgramUniform3f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y, value.z);
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform1iv(m_id, location, count, values);
+}
+
+void Shader::setMat3(const std::string& name, const glm::mat3& value) {
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniformMatrix3fv(m_id, location, 1, false, glm::value_ptr(value));
+}
+
+void Shader::setMat4(const std::string& name, const glm::mat4& value) {
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniformMatrix4fv(m_id, location, 1, false, glm::value_ptr(value));
 }
 
-void Shader::setVec2(std::string name, const glm::vec2& value)
+void Shader::setMat4Array(const std::string& name, const glm::mat4* values, int count) {
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniformMatrix4fv(m_id, location, count, false, glm::value_ptr(values[0]));
+}
+
+void Shader::setVec3(const std::string& name, const glm::vec3& value)
+{
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform3f(m_id, location, value.x, value.y, value.z);
+}
+
+void Shader::setVec4(const std::string& name, const glm::vec4& value)
+{
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform4f(m_id, location, value.x, value.y, value.z, value.w);
+}
+
+void Shader::setVec4Array(const std::string& name, const glm::vec4* values, int count)
+{
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform4fv(m_id, location, count, glm::value_ptr(values[0]));
+}
+
+void Shader::setVec2(const std::string& name, const glm::vec2& value)
 {
-	glProgramUniform2f(m_id, glGetUniformLocation(m_id, name.c_str()), value.x, value.y);
+	GLint location = findLocation(name);
+	if (location >= 0)
+		glProgramUniform2f(m_id, location, value.x, value.y);
 }
 
+template <> void UniformHandle<float>::set(const float& value)const { if (mLocation >= 0) glProgramUniform1f(mProgram, mLocation, value); }
+template <> void UniformHandle<int>::set(const int& value)const { if (mLocation >= 0) glProgramUniform1i(mProgram, mLocation, value); }
+template <> void UniformHandle<glm::vec2>::set(const glm::vec2& value)const { if (mLocation >= 0) glProgramUniform2fv(mProgram, mLocation, 1, glm::value_ptr(value)); }
+template <> void UniformHandle<glm::vec3>::set(const glm::vec3& value)const { if (mLocation >= 0) glProgramUniform3fv(mProgram, mLocation, 1, glm::value_ptr(value)); }
+template <> void UniformHandle<glm::vec4>::set(const glm::vec4& value)const { if (mLocation >= 0) glProgramUniform4fv(mProgram, mLocation, 1, glm::value_ptr(value)); }
+template <> void UniformHandle<glm::mat3>::set(const glm::mat3& value)const { if (mLocation >= 0) glProgramUniformMatrix3fv(mProgram, mLocation, 1, false, glm::value_ptr(value)); }
+template <> void UniformHandle<glm::mat4>::set(const glm::mat4& value)const { if (mLocation >= 0) glProgramUniformMatrix4fv(mProgram, mLocation, 1, false, glm::value_ptr(value)); }
 
+template <> void UniformHandle<float>::setArray(const float* values, int count)const { if (mLocation >= 0) glProgramUniform1fv(mProgram, mLocation, count, values); }
+template <> void UniformHandle<int>::setArray(const int* values, int count)const { if (mLocation >= 0) glProgramUniform1iv(mProgram, mLocation, count, values); }
+template <> void UniformHandle<glm::vec2>::setArray(const glm::vec2* values, int count)const { if (mLocation >= 0) glProgramUniform2fv(mProgram, mLocation, count, glm::value_ptr(values[0])); }
+template <> void UniformHandle<glm::vec3>::setArray(const glm::vec3* values, int count)const { if (mLocation >= 0) glProgramUniform3fv(mProgram, mLocation, count, glm::value_ptr(values[0])); }
+template <> void UniformHandle<glm::vec4>::setArray(const glm::vec4* values, int count)const { if (mLocation >= 0) glProgramUniform4fv(mProgram, mLocation, count, glm::value_ptr(values[0])); }
+template <> void UniformHandle<glm::mat3>::setArray(const glm::mat3* values, int count)const { if (mLocation >= 0) glProgramUniformMatrix3fv(mProgram, mLocation, count, false, glm::value_ptr(values[0])); }
+template <> void UniformHandle<glm::mat4>::setArray(const glm::mat4* values, int count)const { if (mLocation >= 0) glProgramUniformMatrix4fv(mProgram, mLocation, count, false, glm::value_ptr(values[0])); }
+
+
+//Lines of the form #include "file" are replaced by that file, found relative to the including file
 std::string Shader::readFile(const std::string& filePath)
 {
 	std::ifstream fileStream;
@@ -115,8 +305,20 @@ std::string Shader::readFile(const std::string& filePath)
 	if (!fileStream.is_open()) {
 		printf("Failed to open file %s ", filePath.c_str());
 	}
+	std::string folder = filePath.substr(0, filePath.find_last_of("/\\") + 1);
 	std::stringstream stringStream;
-	stringStream << fileStream.rdbuf();
+	std::string line;
+	while (std::getline(fileStream, line)) {
+		size_t directive = line.find_first_not_of(" \t");
+		if (directive != std::string::npos && line.compare(directive, 10, "#include \"") == 0) {
+			size_t nameStart = directive + 10;
+			size_t nameEnd = line.find('"', nameStart);
+			stringStream << readFile(folder + line.substr(nameStart, nameEnd - nameStart)) << "\n";
+		}
+		else {
+			stringStream << line << "\n";
+		}
+	}
 	fileStream.close();
 	return stringStream.str();
 }
@@ -133,7 +335,8 @@ GLuint Shader::compileShader(const char* shaderSource, GLenum shaderType)
 	GLint success;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 	if (!success) {
-		const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT";
+		const char* shaderName = shaderType == GL_VERTEX_SHADER ? "VERTEX" : shaderType == GL_GEOMETRY_SHADER ? "GEOMETRY"
+			: shaderType == GL_COMPUTE_SHADER ? "COMPUTE" : "FRAGMENT";
 		//Dump logs into a char array - 512 is an arbitrary length
 		GLchar infoLog[512];
 		glGetShaderInfoLog(shader, 512, NULL, infoLog);
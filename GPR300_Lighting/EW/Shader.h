@@ -4,22 +4,109 @@
 #include "GL/glew.h"
 #include <glm/glm.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Location of a uniform resolved once, set without any name lookup. Inactive uniforms have location -1 and setting them does nothing
+/// </summary>
+template <typename T>
+class UniformHandle
+{
+public:
+	UniformHandle() : mProgram(0), mLocation(-1) {}
+	UniformHandle(GLuint program, GLint location) : mProgram(program), mLocation(location) {}
+	void set(const T& value)const;
+	void setArray(const T* values, int count)const;
+	inline bool isActive()const { return mLocation >= 0; }
+private:
+	GLuint mProgram;
+	GLint mLocation;
+};
+
+//Defined in Shader.cpp for the types GLSL uniforms use here
+template <> void UniformHandle<float>::set(const float& value)const;
+template <> void UniformHandle<int>::set(const int& value)const;
+template <> void UniformHandle<glm::vec2>::set(const glm::vec2& value)const;
+template <> void UniformHandle<glm::vec3>::set(const glm::vec3& value)const;
+template <> void UniformHandle<glm::vec4>::set(const glm::vec4& value)const;
+template <> void UniformHandle<glm::mat3>::set(const glm::mat3& value)const;
+template <> void UniformHandle<glm::mat4>::set(const glm::mat4& value)const;
+template <> void UniformHandle<float>::setArray(const float* values, int count)const;
+template <> void UniformHandle<int>::setArray(const int* values, int count)const;
+template <> void UniformHandle<glm::vec2>::setArray(const glm::vec2* values, int count)const;
+template <> void UniformHandle<glm::vec3>::setArray(const glm::vec3* values, int count)const;
+template <> void UniformHandle<glm::vec4>::setArray(const glm::vec4* values, int count)const;
+template <> void UniformHandle<glm::mat3>::setArray(const glm::mat3* values, int count)const;
+template <> void UniformHandle<glm::mat4>::setArray(const glm::mat4* values, int count)const;
 
 class Shader
 {
 public:
+	//Stages after the vertex shader may be given an empty path to leave them out, e.g. for depth only programs.
+	//defines ("#define NAME value" lines) are inserted after the #version line of every stage
 	Shader(std::string vertexShaderPath, std::string fragmentShaderPath);
-	Shader(std::string vertexShaderPath, std::string geometryShaderPath, std::string fragmentShaderPath);
+	Shader(std::string vertexShaderPath, std::string geometryShaderPath, std::string fragmentShaderPath, const std::string& defines = "");
+	//Compute program, dispatched with glDispatchCompute after use()
+	explicit Shader(std::string computeShaderPath);
 	void use();
-	void setFloat(std::string name, float value);
-	void setInt(std::string name, int value);
-	void setMat4(std::string name, const glm::mat4& value);
-	void setVec2(std::string name, const glm::vec2& value);
-	void setVec3(std::string name, const glm::vec3& value);
+	//Handles for uniforms set every draw, resolved once instead of per call. Asking for one counts as setting the uniform
+	template <typename T>
+	UniformHandle<T> getUniform(const std::string& name) { return UniformHandle<T>(m_id, findLocation(name)); }
+	//Name based setters look the location up in the table filled at link time, no driver call.
+	//Uniforms the compiler removed are skipped
+	void setFloat(const std::string& name, float value);
+	void setFloatArray(const std::string& name, const float* values, int count);
+	void setInt(const std::string& name, int value);
+	void setIntArray(const std::string& name, const int* values, int count);
+	void setMat3(const std::string& name, const glm::mat3& value);
+	void setMat4(const std::string& name, const glm::mat4& value);
+	void setMat4Array(const std::string& name, const glm::mat4* values, int count);
+	void setVec2(const std::string& name, const glm::vec2& value);
+	void setVec3(const std::string& name, const glm::vec3& value);
+	void setVec4(const std::string& name, const glm::vec4& value);
+	void setVec4Array(const std::string& name, const glm::vec4* values, int count);
+	GLint getLocation(const std::string& name)const;
+	//Prints the program's active uniforms, blocks and attributes, the uniforms set that aren't active
+	//and the active ones never set since linking
+	void printReport()const;
 private:
+	struct UniformInfo {
+		std::string name;
+		GLenum type;
+		GLint location;
+		GLint arraySize;
+		bool wasSet;
+	};
+	struct BlockInfo {
+		std::string name;
+		GLint binding;
+		GLint dataSize;
+	};
+	struct AttributeInfo {
+		std::string name;
+		GLenum type;
+		GLint location;
+	};
+	struct UniformSlot {
+		GLint location;
+		int uniform;	//Index into m_uniforms
+	};
 	Shader(const Shader& r) = delete;
+	void createProgram(const std::string paths[], const GLenum types[], int numStages, const std::string& defines);
 	std::string readFile(const std::string& filePath);
 	GLuint compileShader(const char* shaderSource, GLenum type);
+	void reflect();
+	//Like getLocation, also records the set for printReport
+	GLint findLocation(const std::string& name);
 	GLuint m_id;
+	std::string m_name;
+	std::vector<UniformInfo> m_uniforms;
+	std::vector<BlockInfo> m_blocks;
+	std::vector<AttributeInfo> m_attributes;
+	//Hashed name of every active uniform, arrays under both "name" and each "name[i]"
+	std::unordered_map<unsigned long long, UniformSlot> m_locations;
+	//Names set at least once without being active, kept only for the report
+	std::unordered_map<unsigned long long, std::string> m_inactiveSets;
 };
 
@@ -0,0 +1,161 @@
+#include "ShaderPermutations.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <glm/gtc/type_ptr.hpp>
+
+ShaderPermutations::ShaderPermutations(std::string vertexShaderPath, std::string fragmentShaderPath, DefineBuilder buildDefines)
+	: mVertexShaderPath(vertexShaderPath), mFragmentShaderPath(fragmentShaderPath), mBuildDefines(buildDefines),
+	mVersion(0), mLastCompileMilliseconds(0.0), mTotalCompileMilliseconds(0.0)
+{
+}
+
+ShaderPermutations::Variant& ShaderPermutations::getVariant(unsigned int features)
+{
+	auto it = mVariants.find(features);
+	if (it != mVariants.end())
+		return it->second;
+
+	auto start = std::chrono::steady_clock::now();
+	Variant& variant = mVariants[features];
+	variant.shader.reset(new Shader(mVertexShaderPath, "", mFragmentShaderPath, mBuildDefines(features)));
+	variant.syncedVersion = 0;
+	mLastCompileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	mTotalCompileMilliseconds += mLastCompileMilliseconds;
+	return variant;
+}
+
+void ShaderPermutations::prewarm(const std::vector<unsigned int>& features)
+{
+	for (unsigned int variantFeatures : features)
+		getVariant(variantFeatures);
+}
+
+Shader& ShaderPermutations::use(unsigned int features)
+{
+	Variant& variant = getVariant(features);
+	//Only uniforms set since this variant was last bound are sent again
+	for (const RecordedUniform& uniform : mUniforms) {
+		if (uniform.version > variant.syncedVersion)
+			apply(*variant.shader, uniform);
+	}
+	variant.syncedVersion = mVersion;
+	variant.shader->use();
+	return *variant.shader;
+}
+
+void ShaderPermutations::record(const std::string& name, UniformType type, const void* data, int numWords)
+{
+	auto it = mUniformIndices.find(name);
+	if (it == mUniformIndices.end()) {
+		it = mUniformIndices.insert({ name, (int)mUniforms.size() }).first;
+		mUniforms.push_back({ name, type, std::vector<int>(), 0 });
+	}
+	RecordedUniform& uniform = mUniforms[it->second];
+	//Setting the same value again doesn't make the variants resend it
+	if (uniform.version != 0 && uniform.type == type && (int)uniform.words.size() == numWords
+		&& memcmp(uniform.words.data(), data, numWords * sizeof(int)) == 0)
+		return;
+	uniform.type = type;
+	uniform.words.assign((const int*)data, (const int*)data + numWords);
+	uniform.version = ++mVersion;
+}
+
+void ShaderPermutations::apply(Shader& shader, const RecordedUniform& uniform)
+{
+	//Variants that compiled the uniform out don't need it, and shouldn't show it as an inactive set in their report
+	if (shader.getLocation(uniform.name) < 0)
+		return;
+	const void* data = uniform.words.data();
+	switch (uniform.type) {
+	case UNIFORM_FLOAT:
+		shader.setFloat(uniform.name, *(const float*)data);
+		break;
+	case UNIFORM_FLOAT_ARRAY:
+		shader.setFloatArray(uniform.name, (const float*)data, (int)uniform.words.size());
+		break;
+	case UNIFORM_INT:
+		shader.setInt(uniform.name, *(const int*)data);
+		break;
+	case UNIFORM_INT_ARRAY:
+		shader.setIntArray(uniform.name, (const int*)data, (int)uniform.words.size());
+		break;
+	case UNIFORM_MAT4:
+		shader.setMat4(uniform.name, glm::make_mat4((const float*)data));
+		break;
+	case UNIFORM_MAT4_ARRAY:
+		shader.setMat4Array(uniform.name, (const glm::mat4*)data, (int)uniform.words.size() / 16);
+		break;
+	case UNIFORM_VEC2:
+		shader.setVec2(uniform.name, glm::make_vec2((const float*)data));
+		break;
+	case UNIFORM_VEC3:
+		shader.setVec3(uniform.name, glm::make_vec3((const float*)data));
+		break;
+	case UNIFORM_VEC4:
+		shader.setVec4(uniform.name, glm::make_vec4((const float*)data));
+		break;
+	case UNIFORM_VEC4_ARRAY:
+		shader.setVec4Array(uniform.name, (const glm::vec4*)data, (int)uniform.words.size() / 4);
+		break;
+	}
+}
+
+void ShaderPermutations::setFloat(const std::string& name, float value)
+{
+	record(name, UNIFORM_FLOAT, &value, 1);
+}
+
+void ShaderPermutations::setFloatArray(const std::string& name, const float* values, int count)
+{
+	record(name, UNIFORM_FLOAT_ARRAY, values, count);
+}
+
+void ShaderPermutations::setInt(const std::string& name, int value)
+{
+	record(name, UNIFORM_INT, &value, 1);
+}
+
+void ShaderPermutations::setIntArray(const std::string& name, const int* values, int count)
+{
+	record(name, UNIFORM_INT_ARRAY, values, count);
+}
+
+void ShaderPermutations::setMat4(const std::string& name, const glm::mat4& value)
+{
+	record(name, UNIFORM_MAT4, glm::value_ptr(value), 16);
+}
+
+void ShaderPermutations::setMat4Array(const std::string& name, const glm::mat4* values, int count)
+{
+	record(name, UNIFORM_MAT4_ARRAY, glm::value_ptr(values[0]), count * 16);
+}
+
+void ShaderPermutations::setVec2(const std::string& name, const glm::vec2& value)
+{
+	record(name, UNIFORM_VEC2, glm::value_ptr(value), 2);
+}
+
+void ShaderPermutations::setVec3(const std::string& name, const glm::vec3& value)
+{
+	record(name, UNIFORM_VEC3, glm::value_ptr(value), 3);
+}
+
+void ShaderPermutations::setVec4(const std::string& name, const glm::vec4& value)
+{
+	record(name, UNIFORM_VEC4, glm::value_ptr(value), 4);
+}
+
+void ShaderPermutations::setVec4Array(const std::string& name, const glm::vec4* values, int count)
+{
+	record(name, UNIFORM_VEC4_ARRAY, glm::value_ptr(values[0]), count * 4);
+}
+
+void ShaderPermutations::printReport()const
+{
+	printf("%d variants of %s + %s, %.1f ms compiling\n", (int)mVariants.size(), mVertexShaderPath.c_str(), mFragmentShaderPath.c_str(), mTotalCompileMilliseconds);
+	for (const auto& variant : mVariants) {
+		printf("Features 0x%X: ", variant.first);
+		variant.second.shader->printReport();
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "Shader.h"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Variants of one program, each compiled with the #defines its feature bits map to. A variant is compiled the first time
+/// it is asked for (or by prewarm) and kept. Uniforms set here are recorded and replayed into a variant when it is bound,
+/// so callers set them once a frame as they would on a single Shader.
+/// </summary>
+class ShaderPermutations
+{
+public:
+	//Turns feature bits into "#define NAME value" lines
+	typedef std::string(*DefineBuilder)(unsigned int features);
+
+	ShaderPermutations(std::string vertexShaderPath, std::string fragmentShaderPath, DefineBuilder buildDefines);
+	//Compiles any of the variants that aren't compiled yet, so they don't hitch the frame they are first drawn in
+	void prewarm(const std::vector<unsigned int>& features);
+	//Binds the variant, compiling it if needed, after bringing its uniforms up to date
+	Shader& use(unsigned int features);
+
+	void setFloat(const std::string& name, float value);
+	void setFloatArray(const std::string& name, const float* values, int count);
+	void setInt(const std::string& name, int value);
+	void setIntArray(const std::string& name, const int* values, int count);
+	void setMat4(const std::string& name, const glm::mat4& value);
+	void setMat4Array(const std::string& name, const glm::mat4* values, int count);
+	void setVec2(const std::string& name, const glm::vec2& value);
+	void setVec3(const std::string& name, const glm::vec3& value);
+	void setVec4(const std::string& name, const glm::vec4& value);
+	void setVec4Array(const std::string& name, const glm::vec4* values, int count);
+
+	void printReport()const;
+	inline int getNumVariants()const { return (int)mVariants.size(); }
+	inline double getLastCompileMilliseconds()const { return mLastCompileMilliseconds; }
+	inline double getTotalCompileMilliseconds()const { return mTotalCompileMilliseconds; }
+private:
+	ShaderPermutations(const ShaderPermutations& r) = delete;
+	enum UniformType {
+		UNIFORM_FLOAT, UNIFORM_FLOAT_ARRAY, UNIFORM_INT, UNIFORM_INT_ARRAY, UNIFORM_MAT4, UNIFORM_MAT4_ARRAY,
+		UNIFORM_VEC2, UNIFORM_VEC3, UNIFORM_VEC4, UNIFORM_VEC4_ARRAY
+	};
+	//Last value set for a name, floats and ints are both kept as 4 byte words
+	struct RecordedUniform {
+		std::string name;
+		UniformType type;
+		std::vector<int> words;
+		unsigned long long version;
+	};
+	struct Variant {
+		std::unique_ptr<Shader> shader;
+		unsigned long long syncedVersion;
+	};
+	Variant& getVariant(unsigned int features);
+	void record(const std::string& name, UniformType type, const void* data, int numWords);
+	void apply(Shader& shader, const RecordedUniform& uniform);
+
+	std::string mVertexShaderPath;
+	std::string mFragmentShaderPath;
+	DefineBuilder mBuildDefines;
+	std::unordered_map<unsigned int, Variant> mVariants;
+	std::unordered_map<std::string, int> mUniformIndices;
+	std::vector<RecordedUniform> mUniforms;
+	unsigned long long mVersion;
+	double mLastCompileMilliseconds;
+	double mTotalCompileMilliseconds;
+};
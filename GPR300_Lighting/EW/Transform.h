@@ -13,10 +13,38 @@ namespace ew {
 		glm::mat4 getModelMatrix() {
 			return ew::translate(position) * ew::rotateX(rotation.x) * ew::rotateY(rotation.y) * ew::rotateZ(rotation.z) * ew::scale(scale);
 		}
+		//Inverse transpose of the model matrix's rotation and scale, for normals and tangents.
+		//Only recomputed when rotation or scale changed since the last call, translation doesn't affect it
+		glm::mat3 getNormalMatrix() {
+			if (!mNormalMatrixValid || rotation != mNormalRotation || scale != mNormalScale) {
+				mNormalMatrix = glm::transpose(glm::inverse(glm::mat3(getModelMatrix())));
+				mNormalRotation = rotation;
+				mNormalScale = scale;
+				mNormalMatrixValid = true;
+			}
+			return mNormalMatrix;
+		}
 		void reset() {
 			position = glm::vec3(0);
 			rotation = glm::vec3(0);
 			scale = glm::vec3(1);
 		}
+		//True if the transform changed since the last markClean()
+		bool isDirty()const {
+			return position != mCleanPosition || rotation != mCleanRotation || scale != mCleanScale;
+		}
+		void markClean() {
+			mCleanPosition = position;
+			mCleanRotation = rotation;
+			mCleanScale = scale;
+		}
+	private:
+		glm::vec3 mCleanPosition = glm::vec3(0);
+		glm::vec3 mCleanRotation = glm::vec3(0);
+		glm::vec3 mCleanScale = glm::vec3(1);
+		glm::mat3 mNormalMatrix = glm::mat3(1);
+		glm::vec3 mNormalRotation = glm::vec3(0);
+		glm::vec3 mNormalScale = glm::vec3(1);
+		bool mNormalMatrixValid = false;
 	};
 }
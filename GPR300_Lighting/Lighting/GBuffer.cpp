@@ -0,0 +1,91 @@
+#include "GBuffer.h"
+#include <stdio.h>
+
+GBuffer::GBuffer()
+	: mNormalTexture(0), mAlbedoTexture(0), mMaterialTexture(0), mDepthTexture(0), mFBO(0), mTileLightsBuffer(0),
+	mWidth(0), mHeight(0)
+{
+}
+
+GBuffer::~GBuffer()
+{
+	release();
+}
+
+void GBuffer::release()
+{
+	glDeleteFramebuffers(1, &mFBO);
+	glDeleteTextures(1, &mNormalTexture);
+	glDeleteTextures(1, &mAlbedoTexture);
+	glDeleteTextures(1, &mMaterialTexture);
+	glDeleteTextures(1, &mDepthTexture);
+	glDeleteBuffers(1, &mTileLightsBuffer);
+	mFBO = mNormalTexture = mAlbedoTexture = mMaterialTexture = mDepthTexture = mTileLightsBuffer = 0;
+}
+
+void GBuffer::resize(int screenWidth, int screenHeight)
+{
+	if (mFBO != 0 && (screenWidth == mWidth || screenWidth <= 0) && (screenHeight == mHeight || screenHeight <= 0))
+		return;
+	release();
+	//A minimized window reports 0x0
+	mWidth = screenWidth > 0 ? screenWidth : 1;
+	mHeight = screenHeight > 0 ? screenHeight : 1;
+
+	//Every target is read with texelFetch, no filtering
+	const GLenum formats[4] = { GL_RG16F, GL_RGBA8, GL_RGBA8, GL_DEPTH24_STENCIL8 };
+	GLuint* textures[4] = { &mNormalTexture, &mAlbedoTexture, &mMaterialTexture, &mDepthTexture };
+	for (int i = 0; i < 4; i++) {
+		glGenTextures(1, textures[i]);
+		glBindTexture(GL_TEXTURE_2D, *textures[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], mWidth, mHeight);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	glGenFramebuffers(1, &mFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mNormalTexture, 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, mAlbedoTexture, 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, mMaterialTexture, 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, mDepthTexture, 0);
+	const GLenum drawBuffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Error loading G-Buffer FBO");
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	//A count and MAX_TILE_LIGHTS references per tile
+	glGenBuffers(1, &mTileLightsBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTileLightsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)getNumTilesX() * getNumTilesY() * (MAX_TILE_LIGHTS + 1) * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_LIGHTS_BINDING, mTileLightsBuffer);
+}
+
+void GBuffer::bindForWriting()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glViewport(0, 0, mWidth, mHeight);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	//Material alpha holds shininess and normals are two channels, blending would mix them with what's behind
+	glDisable(GL_BLEND);
+}
+
+void GBuffer::bindTextures(GLenum firstTextureUnit)
+{
+	const GLuint textures[4] = { mNormalTexture, mAlbedoTexture, mMaterialTexture, mDepthTexture };
+	for (int i = 0; i < 4; i++) {
+		glActiveTexture(firstTextureUnit + i);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+	}
+}
+
+void GBuffer::blitDepthToScreen()
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mFBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
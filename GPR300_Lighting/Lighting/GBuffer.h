@@ -0,0 +1,49 @@
+#pragma once
+#include "GL/glew.h"
+
+//Forward shades every fragment drawn, tiled deferred fills the G-buffer first and shades each pixel once
+enum RenderPath {
+	RENDER_PATH_FORWARD,
+	RENDER_PATH_TILED_DEFERRED
+};
+
+//Shader storage binding of TileLights in shaders/tileLights.glsl
+const GLuint TILE_LIGHTS_BINDING = 4;
+
+/// <summary>
+/// Render targets of the deferred path, laid out as in shaders/gBuffer.glsl: octahedral normal (RG16F),
+/// albedo (RGBA8), material (RGBA8) and depth, 12 bytes of color per pixel.
+/// Also holds the per tile light lists tileLightCulling.comp writes, sized with the screen.
+/// </summary>
+class GBuffer
+{
+public:
+	//Mirrors shaders/tileLights.glsl
+	static const int TILE_SIZE = 16;
+	static const int MAX_TILE_LIGHTS = 255;
+
+	GBuffer();
+	~GBuffer();
+	//Reallocates only when the screen size changed
+	void resize(int screenWidth, int screenHeight);
+	//Binds and clears the targets for the geometry pass. Also disables blending, the caller turns it back on
+	void bindForWriting();
+	//Normal, albedo, material and depth on four consecutive units starting at firstTextureUnit
+	void bindTextures(GLenum firstTextureUnit);
+	//Copies the depth into the default framebuffer, for forward draws after the lighting pass.
+	//The default framebuffer's depth is assumed to be 24 bit depth with 8 bit stencil like this one
+	void blitDepthToScreen();
+	inline int getNumTilesX()const { return (mWidth + TILE_SIZE - 1) / TILE_SIZE; }
+	inline int getNumTilesY()const { return (mHeight + TILE_SIZE - 1) / TILE_SIZE; }
+private:
+	GBuffer(const GBuffer& r) = delete;
+	void release();
+	GLuint mNormalTexture;
+	GLuint mAlbedoTexture;
+	GLuint mMaterialTexture;
+	GLuint mDepthTexture;
+	GLuint mFBO;
+	GLuint mTileLightsBuffer;
+	int mWidth;
+	int mHeight;
+};
@@ -0,0 +1,157 @@
+#include "InstanceBatches.h"
+#include <stddef.h>
+#include <algorithm>
+
+//Meshes use bindings 0-3 for their own attributes
+static const GLuint INSTANCE_BINDING = 15;
+
+InstanceBatches::InstanceBatches()
+	: mShadowCapacity(0), mShadowDrawCalls(0), mShadowInstances(0)
+{
+	glCreateBuffers(1, &mInstanceBuffer);
+	glCreateBuffers(1, &mShadowInstanceBuffer);
+}
+
+InstanceBatches::~InstanceBatches()
+{
+	glDeleteBuffers(1, &mInstanceBuffer);
+	glDeleteBuffers(1, &mShadowInstanceBuffer);
+}
+
+void InstanceBatches::build(const std::vector<ew::Mesh*>& meshes, const std::vector<int>& groups)
+{
+	mBatches.clear();
+	for (size_t i = 0; i < meshes.size(); i++) {
+		Batch* batch = NULL;
+		for (Batch& existing : mBatches) {
+			if (existing.mesh == meshes[i] && existing.group == groups[i])
+				batch = &existing;
+		}
+		if (batch == NULL) {
+			mBatches.push_back({ meshes[i], groups[i], 0, {} });
+			batch = &mBatches.back();
+		}
+		batch->objects.push_back((int)i);
+	}
+	GLuint first = 0;
+	for (Batch& batch : mBatches) {
+		batch.firstInstance = first;
+		first += (GLuint)batch.objects.size();
+	}
+	mModels.assign(meshes.size(), glm::mat4(1.0f));
+	mInstances.resize(meshes.size());
+	glNamedBufferData(mInstanceBuffer, std::max(mInstances.size(), (size_t)1) * sizeof(Instance), NULL, GL_DYNAMIC_DRAW);
+	//Non instanced draws leave these attributes enabled, layered ones read up to one instance per cube array layer
+	reserveShadowInstances(MAX_LIGHTS * 6);
+
+	for (Batch& batch : mBatches) {
+		GLuint vao = batch.mesh->getVertexArray();
+		glVertexArrayVertexBuffer(vao, INSTANCE_BINDING, mInstanceBuffer, 0, sizeof(Instance));
+		glVertexArrayBindingDivisor(vao, INSTANCE_BINDING, 1);
+		for (GLuint column = 0; column < 4; column++) {
+			glEnableVertexArrayAttrib(vao, MODEL_LOCATION + column);
+			glVertexArrayAttribFormat(vao, MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, model) + column * sizeof(glm::vec4));
+			glVertexArrayAttribBinding(vao, MODEL_LOCATION + column, INSTANCE_BINDING);
+		}
+		for (GLuint column = 0; column < 3; column++) {
+			glEnableVertexArrayAttrib(vao, NORMAL_MATRIX_LOCATION + column);
+			glVertexArrayAttribFormat(vao, NORMAL_MATRIX_LOCATION + column, 3, GL_FLOAT, GL_FALSE, offsetof(Instance, normalMatrix) + column * sizeof(glm::vec3));
+			glVertexArrayAttribBinding(vao, NORMAL_MATRIX_LOCATION + column, INSTANCE_BINDING);
+		}
+
+		GLuint depthVao = batch.mesh->getDepthVertexArray();
+		glVertexArrayVertexBuffer(depthVao, INSTANCE_BINDING, mShadowInstanceBuffer, 0, sizeof(ShadowInstance));
+		glVertexArrayBindingDivisor(depthVao, INSTANCE_BINDING, 1);
+		for (GLuint column = 0; column < 4; column++) {
+			glEnableVertexArrayAttrib(depthVao, SHADOW_MODEL_LOCATION + column);
+			glVertexArrayAttribFormat(depthVao, SHADOW_MODEL_LOCATION + column, 4, GL_FLOAT, GL_FALSE, offsetof(ShadowInstance, model) + column * sizeof(glm::vec4));
+			glVertexArrayAttribBinding(depthVao, SHADOW_MODEL_LOCATION + column, INSTANCE_BINDING);
+		}
+		for (GLuint half = 0; half < 2; half++) {
+			glEnableVertexArrayAttrib(depthVao, SHADOW_FACE_MASKS_LOCATION + half);
+			glVertexArrayAttribIFormat(depthVao, SHADOW_FACE_MASKS_LOCATION + half, 4, GL_INT, offsetof(ShadowInstance, faceMasks) + half * sizeof(glm::ivec4));
+			glVertexArrayAttribBinding(depthVao, SHADOW_FACE_MASKS_LOCATION + half, INSTANCE_BINDING);
+		}
+		glEnableVertexArrayAttrib(depthVao, SHADOW_LAYER_LOCATION);
+		glVertexArrayAttribIFormat(depthVao, SHADOW_LAYER_LOCATION, 1, GL_INT, offsetof(ShadowInstance, layer));
+		glVertexArrayAttribBinding(depthVao, SHADOW_LAYER_LOCATION, INSTANCE_BINDING);
+	}
+}
+
+void InstanceBatches::updateTransforms(const std::vector<glm::mat4>& models, const std::vector<glm::mat3>& normalMatrices)
+{
+	mModels = models;
+	for (const Batch& batch : mBatches) {
+		for (size_t i = 0; i < batch.objects.size(); i++) {
+			Instance& instance = mInstances[batch.firstInstance + i];
+			instance.model = models[batch.objects[i]];
+			instance.normalMatrix = normalMatrices[batch.objects[i]];
+		}
+	}
+	if (!mInstances.empty())
+		glNamedBufferSubData(mInstanceBuffer, 0, mInstances.size() * sizeof(Instance), mInstances.data());
+}
+
+void InstanceBatches::draw(const Batch& batch)
+{
+	batch.mesh->drawInstanced((GLsizei)batch.objects.size(), batch.firstInstance);
+}
+
+void InstanceBatches::drawShadowCasters(const std::vector<int>& casterFaceMasks, bool vertexLayer)
+{
+	//Every batch's casters go into one upload, then each batch draws its own range
+	mShadowInstanceData.clear();
+	mShadowBatchCounts.assign(mBatches.size(), 0);
+	for (size_t b = 0; b < mBatches.size(); b++) {
+		size_t batchStart = mShadowInstanceData.size();
+		for (int object : mBatches[b].objects) {
+			const int* faceMasks = &casterFaceMasks[object * MAX_LIGHTS];
+			ShadowInstance instance;
+			instance.model = mModels[object];
+			instance.layer = 0;
+			bool anyFaces = false;
+			for (int light = 0; light < MAX_LIGHTS; light++) {
+				instance.faceMasks[light / 4][light % 4] = faceMasks[light];
+				anyFaces |= faceMasks[light] != 0;
+			}
+			if (!anyFaces)
+				continue;
+			if (!vertexLayer) {
+				mShadowInstanceData.push_back(instance);
+				continue;
+			}
+			for (int light = 0; light < MAX_LIGHTS; light++) {
+				for (int face = 0; face < 6; face++) {
+					if (faceMasks[light] & (1 << face)) {
+						instance.layer = light * 6 + face;
+						mShadowInstanceData.push_back(instance);
+					}
+				}
+			}
+		}
+		mShadowBatchCounts[b] = (GLuint)(mShadowInstanceData.size() - batchStart);
+	}
+
+	mShadowDrawCalls = 0;
+	mShadowInstances = (int)mShadowInstanceData.size();
+	if (mShadowInstanceData.empty())
+		return;
+	reserveShadowInstances(mShadowInstanceData.size());
+	glNamedBufferSubData(mShadowInstanceBuffer, 0, mShadowInstanceData.size() * sizeof(ShadowInstance), mShadowInstanceData.data());
+	GLuint first = 0;
+	for (size_t b = 0; b < mBatches.size(); b++) {
+		if (mShadowBatchCounts[b] == 0)
+			continue;
+		mBatches[b].mesh->drawDepthInstanced((GLsizei)mShadowBatchCounts[b], first);
+		first += mShadowBatchCounts[b];
+		mShadowDrawCalls++;
+	}
+}
+
+void InstanceBatches::reserveShadowInstances(size_t count)
+{
+	if (count <= mShadowCapacity)
+		return;
+	mShadowCapacity = std::max(count, mShadowCapacity * 2);
+	glNamedBufferData(mShadowInstanceBuffer, mShadowCapacity * sizeof(ShadowInstance), NULL, GL_DYNAMIC_DRAW);
+}
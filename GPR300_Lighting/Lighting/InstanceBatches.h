@@ -0,0 +1,71 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include "Lights.h"
+#include "../EW/Mesh.h"
+
+/// <summary>
+/// Draws objects that share a mesh with one instanced call instead of one draw per object.
+/// Objects are batched by mesh and by a caller chosen group (e.g. the shader variant they need). Each batch is a
+/// contiguous range of one instance buffer holding every object's model and normal matrix, drawn with a base instance.
+/// Shadow casters get a second instance buffer, rebuilt every shadow pass from the faces each caster still has to be drawn to.
+/// </summary>
+class InstanceBatches
+{
+public:
+	//Per instance attributes of the mesh's full vertex array, after its own 0-3
+	static const GLuint MODEL_LOCATION = 4;				//mat4, 4 locations
+	static const GLuint NORMAL_MATRIX_LOCATION = 8;		//mat3, 3 locations
+	//Per instance attributes of the position only vertex array
+	static const GLuint SHADOW_MODEL_LOCATION = 1;		//mat4, 4 locations
+	static const GLuint SHADOW_FACE_MASKS_LOCATION = 5;	//Two ivec4, light i's cube faces in [i / 4][i % 4]
+	static const GLuint SHADOW_LAYER_LOCATION = 7;		//Cube array layer, vertex layer path only
+
+	struct Batch {
+		ew::Mesh* mesh;
+		int group;
+		GLuint firstInstance;
+		std::vector<int> objects;	//Indices into the objects given to build()
+	};
+
+	InstanceBatches();
+	~InstanceBatches();
+	//Sorts the objects into batches, in order of first appearance, and attaches the instance buffers to their meshes
+	void build(const std::vector<ew::Mesh*>& meshes, const std::vector<int>& groups);
+	//Per object, in the order given to build()
+	void updateTransforms(const std::vector<glm::mat4>& models, const std::vector<glm::mat3>& normalMatrices);
+	void draw(const Batch& batch);
+	//casterFaceMasks holds MAX_LIGHTS masks per object. Casters with no faces are left out, the others are one instance each
+	//(the geometry shader fans out to the faces) or, with vertexLayer, one instance per cube array layer
+	void drawShadowCasters(const std::vector<int>& casterFaceMasks, bool vertexLayer);
+
+	inline const std::vector<Batch>& getBatches()const { return mBatches; }
+	inline int getNumObjects()const { return (int)mModels.size(); }
+	//Last drawShadowCasters call
+	inline int getShadowDrawCalls()const { return mShadowDrawCalls; }
+	inline int getShadowInstances()const { return mShadowInstances; }
+private:
+	InstanceBatches(const InstanceBatches& r) = delete;
+	struct Instance {
+		glm::mat4 model;
+		glm::mat3 normalMatrix;
+	};
+	struct ShadowInstance {
+		glm::mat4 model;
+		glm::ivec4 faceMasks[2];
+		GLint layer;
+	};
+	void reserveShadowInstances(size_t count);
+
+	std::vector<Batch> mBatches;
+	std::vector<glm::mat4> mModels;
+	std::vector<Instance> mInstances;
+	std::vector<ShadowInstance> mShadowInstanceData;
+	std::vector<GLuint> mShadowBatchCounts;
+	GLuint mInstanceBuffer;
+	GLuint mShadowInstanceBuffer;
+	size_t mShadowCapacity;
+	int mShadowDrawCalls;
+	int mShadowInstances;
+};
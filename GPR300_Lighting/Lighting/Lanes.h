@@ -0,0 +1,76 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+
+//A few floats at a time: AVX when the compiler targets it (the x64 configurations build with /arch:AVX2), SSE2 on any other
+//x64 build, one float otherwise.
+//Masks are all bits set in the lanes that pass, or 1 / 0 in the scalar version. lanesBits packs them, bit i = lane i
+#if defined(__AVX__)
+#include <immintrin.h>
+typedef __m256 Lanes;
+static const int LANES = 8;
+static inline Lanes lanesSet(float v) { return _mm256_set1_ps(v); }
+static inline Lanes lanesIndex() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+static inline Lanes lanesMask(bool on) { return _mm256_castsi256_ps(_mm256_set1_epi32(on ? -1 : 0)); }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+static inline Lanes lanesMul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+static inline Lanes lanesMin(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+static inline Lanes lanesMax(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+static inline Lanes lanesSqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+static inline Lanes lanesGreater(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline Lanes lanesEqual(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+static inline Lanes lanesAnd(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+static inline Lanes lanesOr(Lanes a, Lanes b) { return _mm256_or_ps(a, b); }
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b) { return _mm256_blendv_ps(b, a, mask); }
+static inline bool lanesAny(Lanes mask) { return _mm256_movemask_ps(mask) != 0; }
+static inline int lanesBits(Lanes mask) { return _mm256_movemask_ps(mask); }
+static inline Lanes lanesLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void lanesStore(float* p, Lanes a) { _mm256_storeu_ps(p, a); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+typedef __m128 Lanes;
+static const int LANES = 4;
+static inline Lanes lanesSet(float v) { return _mm_set1_ps(v); }
+static inline Lanes lanesIndex() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+static inline Lanes lanesMask(bool on) { return _mm_castsi128_ps(_mm_set1_epi32(on ? -1 : 0)); }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes lanesMul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+static inline Lanes lanesMin(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+static inline Lanes lanesMax(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+static inline Lanes lanesSqrt(Lanes a) { return _mm_sqrt_ps(a); }
+static inline Lanes lanesGreater(Lanes a, Lanes b) { return _mm_cmpgt_ps(a, b); }
+static inline Lanes lanesEqual(Lanes a, Lanes b) { return _mm_cmpeq_ps(a, b); }
+static inline Lanes lanesAnd(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+static inline Lanes lanesOr(Lanes a, Lanes b) { return _mm_or_ps(a, b); }
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+static inline bool lanesAny(Lanes mask) { return _mm_movemask_ps(mask) != 0; }
+static inline int lanesBits(Lanes mask) { return _mm_movemask_ps(mask); }
+static inline Lanes lanesLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void lanesStore(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+#else
+typedef float Lanes;
+static const int LANES = 1;
+static inline Lanes lanesSet(float v) { return v; }
+static inline Lanes lanesIndex() { return 0.0f; }
+static inline Lanes lanesMask(bool on) { return on ? 1.0f : 0.0f; }
+static inline Lanes lanesAdd(Lanes a, Lanes b) { return a + b; }
+static inline Lanes lanesSub(Lanes a, Lanes b) { return a - b; }
+static inline Lanes lanesMul(Lanes a, Lanes b) { return a * b; }
+static inline Lanes lanesDiv(Lanes a, Lanes b) { return a / b; }
+static inline Lanes lanesMin(Lanes a, Lanes b) { return a < b ? a : b; }
+static inline Lanes lanesMax(Lanes a, Lanes b) { return a > b ? a : b; }
+static inline Lanes lanesSqrt(Lanes a) { return sqrtf(a); }
+static inline Lanes lanesGreater(Lanes a, Lanes b) { return a > b ? 1.0f : 0.0f; }
+static inline Lanes lanesEqual(Lanes a, Lanes b) { return a == b ? 1.0f : 0.0f; }
+static inline Lanes lanesAnd(Lanes a, Lanes b) { return a * b; }
+static inline Lanes lanesOr(Lanes a, Lanes b) { return a > b ? a : b; }
+static inline Lanes lanesSelect(Lanes mask, Lanes a, Lanes b) { return mask != 0.0f ? a : b; }
+static inline bool lanesAny(Lanes mask) { return mask != 0.0f; }
+static inline int lanesBits(Lanes mask) { return mask != 0.0f ? 1 : 0; }
+static inline Lanes lanesLoad(const float* p) { return *p; }
+static inline void lanesStore(float* p, Lanes a) { *p = a; }
+#endif
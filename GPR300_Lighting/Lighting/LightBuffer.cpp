@@ -0,0 +1,71 @@
+#include "LightBuffer.h"
+#include <string.h>
+
+LightBuffer::LightBuffer()
+	: mBlock(), mUploadCount(0)
+{
+	glGenBuffers(1, &mUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), &mBlock, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, mUBO);
+}
+
+LightBuffer::~LightBuffer()
+{
+	glDeleteBuffers(1, &mUBO);
+}
+
+bool LightBuffer::update(const PointLight pointLights[MAX_LIGHTS], const DirectionLight dirLights[MAX_LIGHTS], const SpotLight spotLights[MAX_LIGHTS])
+{
+	//Zeroed so the padding and unused indices compare equal too
+	LightBlock block;
+	memset(&block, 0, sizeof(LightBlock));
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		GpuPointLight& point = block.pointLights[i];
+		point.position = pointLights[i].position;
+		point.radius = pointLights[i].radius;
+		point.color = pointLights[i].color;
+		point.intensity = pointLights[i].intensity;
+		point.isOn = pointLights[i].isOn;
+
+		GpuDirectionLight& dir = block.dirLights[i];
+		dir.direction = dirLights[i].direction;
+		dir.intensity = dirLights[i].intensity;
+		dir.color = dirLights[i].color;
+		dir.isOn = dirLights[i].isOn;
+
+		GpuSpotLight& spot = block.spotLights[i];
+		spot.position = spotLights[i].position;
+		spot.radius = spotLights[i].radius;
+		spot.direction = spotLights[i].direction;
+		spot.intensity = spotLights[i].intensity;
+		spot.color = spotLights[i].color;
+		spot.minAngle = spotLights[i].minAngle;
+		spot.maxAngle = spotLights[i].maxAngle;
+		spot.isOn = spotLights[i].isOn;
+
+		glm::ivec4& counts = block.lightCounts;
+		if (pointLights[i].isOn == 1) {
+			block.pointLightIndices[counts.x / 4][counts.x % 4] = i;
+			counts.x++;
+		}
+		if (dirLights[i].isOn == 1) {
+			block.dirLightIndices[counts.y / 4][counts.y % 4] = i;
+			counts.y++;
+		}
+		if (spotLights[i].isOn == 1) {
+			block.spotLightIndices[counts.z / 4][counts.z % 4] = i;
+			counts.z++;
+		}
+	}
+
+	if (mUploadCount > 0 && memcmp(&block, &mBlock, sizeof(LightBlock)) == 0)
+		return false;
+	mBlock = block;
+	glBindBuffer(GL_UNIFORM_BUFFER, mUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &mBlock);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	mUploadCount++;
+	return true;
+}
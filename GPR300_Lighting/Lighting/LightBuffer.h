@@ -0,0 +1,78 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include "Lights.h"
+
+//Uniform block binding of Lights in shaders/lights.glsl
+const GLuint LIGHT_BLOCK_BINDING = 0;
+
+//std140 mirrors of the structs in shaders/lights.glsl. A vec3 is 16 byte aligned there,
+//so each one is followed by a scalar to fill its last 4 bytes, and every struct is padded to a multiple of 16
+struct GpuPointLight {
+	glm::vec3 position;
+	float radius;
+	glm::vec3 color;
+	float intensity;
+	int isOn;
+	int padding[3];
+};
+
+struct GpuDirectionLight {
+	glm::vec3 direction;
+	float intensity;
+	glm::vec3 color;
+	int isOn;
+};
+
+struct GpuSpotLight {
+	glm::vec3 position;
+	float radius;
+	glm::vec3 direction;
+	float intensity;
+	glm::vec3 color;
+	float minAngle;
+	float maxAngle;
+	int isOn;
+	int padding[2];
+};
+
+struct LightBlock {
+	GpuPointLight pointLights[MAX_LIGHTS];
+	GpuDirectionLight dirLights[MAX_LIGHTS];
+	GpuSpotLight spotLights[MAX_LIGHTS];
+	glm::ivec4 lightCounts;							//Lights switched on: point, directional, spot
+	glm::ivec4 pointLightIndices[MAX_LIGHTS / 4];	//Indices of the lights switched on, 4 to an ivec4
+	glm::ivec4 dirLightIndices[MAX_LIGHTS / 4];
+	glm::ivec4 spotLightIndices[MAX_LIGHTS / 4];
+};
+
+static_assert(sizeof(GpuPointLight) == 48 && offsetof(GpuPointLight, color) == 16 && offsetof(GpuPointLight, isOn) == 32, "GpuPointLight doesn't match std140");
+static_assert(sizeof(GpuDirectionLight) == 32 && offsetof(GpuDirectionLight, color) == 16, "GpuDirectionLight doesn't match std140");
+static_assert(sizeof(GpuSpotLight) == 64 && offsetof(GpuSpotLight, direction) == 16 && offsetof(GpuSpotLight, color) == 32
+	&& offsetof(GpuSpotLight, maxAngle) == 48, "GpuSpotLight doesn't match std140");
+static_assert(offsetof(LightBlock, dirLights) == 48 * MAX_LIGHTS && offsetof(LightBlock, spotLights) == 80 * MAX_LIGHTS
+	&& offsetof(LightBlock, lightCounts) == 144 * MAX_LIGHTS && offsetof(LightBlock, pointLightIndices) == 144 * MAX_LIGHTS + 16
+	&& sizeof(LightBlock) == 144 * MAX_LIGHTS + 16 + 3 * 4 * MAX_LIGHTS, "LightBlock doesn't match std140");
+
+/// <summary>
+/// Uniform buffer holding every light, bound to LIGHT_BLOCK_BINDING for all programs.
+/// The block is rebuilt from the light arrays each frame but only uploaded when it differs from the last upload.
+/// Shaders loop over the index lists of the lights switched on instead of testing isOn for every light.
+/// </summary>
+class LightBuffer
+{
+public:
+	LightBuffer();
+	~LightBuffer();
+	//Returns true if the lights changed and were uploaded
+	bool update(const PointLight pointLights[MAX_LIGHTS], const DirectionLight dirLights[MAX_LIGHTS], const SpotLight spotLights[MAX_LIGHTS]);
+	inline int getUploadCount()const { return mUploadCount; }
+	//Lights switched on as of the last update: point, directional, spot
+	inline const glm::ivec4& getLightCounts()const { return mBlock.lightCounts; }
+private:
+	LightBuffer(const LightBuffer& r) = delete;
+	GLuint mUBO;
+	LightBlock mBlock;
+	int mUploadCount;
+};
@@ -0,0 +1,165 @@
+#include "LightClusters.h"
+#include "Lanes.h"
+#include <chrono>
+
+//Padding lanes sit far behind the camera with no radius, they never touch a cluster
+static const float FAR_AWAY = 1e30f;
+
+LightClusters::LightClusters(float nearPlane, float farPlane, int numThreads)
+	: mNearPlane(nearPlane), mFarPlane(farPlane), mWorkers(numThreads), mNumLights(0), mRanges(NUM_CLUSTERS),
+	mMilliseconds(0.0), mMaxLightsPerCluster(0), mAverageLightsPerCluster(0.0f)
+{
+	float logRatio = logf(mFarPlane / mNearPlane);
+	mDepthScale = CLUSTERS_Z / logRatio;
+	mDepthBias = -CLUSTERS_Z * logf(mNearPlane) / logRatio;
+
+	//Empty buffers still need storage to be bound
+	glGenBuffers(3, mBuffers);
+	const GLuint bindings[3] = { CLUSTER_LIGHTS_BINDING, CLUSTER_RANGES_BINDING, CLUSTER_INDICES_BINDING };
+	for (int i = 0; i < 3; i++) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, i == 1 ? sizeof(glm::uvec2) * NUM_CLUSTERS : 16, NULL, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindings[i], mBuffers[i]);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[1]);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::uvec2) * NUM_CLUSTERS, mRanges.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+LightClusters::~LightClusters()
+{
+	glDeleteBuffers(3, mBuffers);
+}
+
+void LightClusters::update(const std::vector<ClusterLight>& lights, const glm::mat4& view, float fovY, float aspectRatio)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	mNumLights = (int)lights.size();
+	size_t paddedLights = (mNumLights + LANES - 1) / LANES * LANES;
+	mViewX.assign(paddedLights, 0.0f);
+	mViewY.assign(paddedLights, 0.0f);
+	mViewZ.assign(paddedLights, FAR_AWAY);
+	mRadius.assign(paddedLights, 0.0f);
+	for (int i = 0; i < mNumLights; i++) {
+		glm::vec4 viewPosition = view * glm::vec4(lights[i].position, 1.0f);
+		mViewX[i] = viewPosition.x;
+		mViewY[i] = viewPosition.y;
+		mViewZ[i] = viewPosition.z;
+		mRadius[i] = lights[i].radius;
+	}
+
+	float tanHalfFovY = tanf(glm::radians(fovY) * 0.5f);
+	float tanHalfFovX = tanHalfFovY * aspectRatio;
+	mWorkers.parallelFor(CLUSTERS_Z, [&](int slice) {
+		assignSlice(slice, tanHalfFovX, tanHalfFovY);
+	});
+
+	//Slices were filled apart, their lists are joined into one and the offsets moved to match
+	size_t total = 0;
+	for (int slice = 0; slice < CLUSTERS_Z; slice++)
+		total += mSliceIndices[slice].size();
+	mIndices.resize(total);
+	GLuint base = 0;
+	int nonEmpty = 0;
+	mMaxLightsPerCluster = 0;
+	for (int slice = 0; slice < CLUSTERS_Z; slice++) {
+		std::copy(mSliceIndices[slice].begin(), mSliceIndices[slice].end(), mIndices.begin() + base);
+		for (int cluster = slice * CLUSTERS_X * CLUSTERS_Y; cluster < (slice + 1) * CLUSTERS_X * CLUSTERS_Y; cluster++) {
+			mRanges[cluster].x += base;
+			mMaxLightsPerCluster = std::max(mMaxLightsPerCluster, (int)mRanges[cluster].y);
+			nonEmpty += mRanges[cluster].y > 0;
+		}
+		base += (GLuint)mSliceIndices[slice].size();
+	}
+	mAverageLightsPerCluster = nonEmpty > 0 ? (float)total / nonEmpty : 0.0f;
+
+	//Sizes change with the light count, so each buffer is reallocated rather than updated in place
+	uploadLights(lights);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[1]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::uvec2) * NUM_CLUSTERS, mRanges.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[2]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(total, (size_t)1) * sizeof(GLuint), mIndices.empty() ? NULL : mIndices.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	mMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightClusters::uploadLights(const std::vector<ClusterLight>& lights)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(lights.size(), (size_t)1) * sizeof(ClusterLight), lights.empty() ? NULL : lights.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightClusters::assignSlice(int slice, float tanHalfFovX, float tanHalfFovY)
+{
+	//The first slice reaches back to the camera and the last one ends at the far plane
+	float sliceNear = slice == 0 ? 0.0f : mNearPlane * powf(mFarPlane / mNearPlane, (float)slice / CLUSTERS_Z);
+	float sliceFar = mNearPlane * powf(mFarPlane / mNearPlane, (float)(slice + 1) / CLUSTERS_Z);
+
+	//Lights whose depth range overlaps the slice, view space looks down -z
+	std::vector<float> candidateX, candidateY, candidateZ, candidateRadius;
+	std::vector<GLuint> candidates;
+	Lanes nearLanes = lanesSet(sliceNear);
+	Lanes farLanes = lanesSet(sliceFar);
+	for (size_t i = 0; i < mViewZ.size(); i += LANES) {
+		Lanes depth = lanesSub(lanesSet(0.0f), lanesLoad(&mViewZ[i]));
+		Lanes radius = lanesLoad(&mRadius[i]);
+		int bits = lanesBits(lanesAnd(lanesGreater(lanesAdd(depth, radius), nearLanes), lanesGreater(farLanes, lanesSub(depth, radius))));
+		for (int lane = 0; bits != 0; lane++, bits >>= 1) {
+			if ((bits & 1) == 0)
+				continue;
+			size_t light = i + lane;
+			candidates.push_back((GLuint)light);
+			candidateX.push_back(mViewX[light]);
+			candidateY.push_back(mViewY[light]);
+			candidateZ.push_back(mViewZ[light]);
+			candidateRadius.push_back(mRadius[light] * mRadius[light]);
+		}
+	}
+	size_t paddedCandidates = (candidates.size() + LANES - 1) / LANES * LANES;
+	candidateX.resize(paddedCandidates, FAR_AWAY);
+	candidateY.resize(paddedCandidates, FAR_AWAY);
+	candidateZ.resize(paddedCandidates, FAR_AWAY);
+	candidateRadius.resize(paddedCandidates, 0.0f);
+
+	std::vector<GLuint>& indices = mSliceIndices[slice];
+	indices.clear();
+	const int fullMask = (1 << LANES) - 1;
+	Lanes zero = lanesSet(0.0f);
+	for (int y = 0; y < CLUSTERS_Y; y++) {
+		float ndcY0 = -1.0f + 2.0f * y / CLUSTERS_Y;
+		float ndcY1 = -1.0f + 2.0f * (y + 1) / CLUSTERS_Y;
+		for (int x = 0; x < CLUSTERS_X; x++) {
+			float ndcX0 = -1.0f + 2.0f * x / CLUSTERS_X;
+			float ndcX1 = -1.0f + 2.0f * (x + 1) / CLUSTERS_X;
+			//Bounds of the tile's frustum between the slice's near and far depth
+			float xs[4] = { ndcX0 * sliceNear, ndcX0 * sliceFar, ndcX1 * sliceNear, ndcX1 * sliceFar };
+			float ys[4] = { ndcY0 * sliceNear, ndcY0 * sliceFar, ndcY1 * sliceNear, ndcY1 * sliceFar };
+			glm::vec3 minBounds(*std::min_element(xs, xs + 4) * tanHalfFovX, *std::min_element(ys, ys + 4) * tanHalfFovY, -sliceFar);
+			glm::vec3 maxBounds(*std::max_element(xs, xs + 4) * tanHalfFovX, *std::max_element(ys, ys + 4) * tanHalfFovY, -sliceNear);
+			Lanes minX = lanesSet(minBounds.x), minY = lanesSet(minBounds.y), minZ = lanesSet(minBounds.z);
+			Lanes maxX = lanesSet(maxBounds.x), maxY = lanesSet(maxBounds.y), maxZ = lanesSet(maxBounds.z);
+
+			glm::uvec2& range = mRanges[(slice * CLUSTERS_Y + y) * CLUSTERS_X + x];
+			range = glm::uvec2((GLuint)indices.size(), 0);
+			for (size_t i = 0; i < paddedCandidates; i += LANES) {
+				//Distance from each sphere's center to the box, against its radius
+				Lanes cx = lanesLoad(&candidateX[i]);
+				Lanes cy = lanesLoad(&candidateY[i]);
+				Lanes cz = lanesLoad(&candidateZ[i]);
+				Lanes dx = lanesMax(lanesMax(lanesSub(minX, cx), lanesSub(cx, maxX)), zero);
+				Lanes dy = lanesMax(lanesMax(lanesSub(minY, cy), lanesSub(cy, maxY)), zero);
+				Lanes dz = lanesMax(lanesMax(lanesSub(minZ, cz), lanesSub(cz, maxZ)), zero);
+				Lanes distance2 = lanesAdd(lanesAdd(lanesMul(dx, dx), lanesMul(dy, dy)), lanesMul(dz, dz));
+				int bits = ~lanesBits(lanesGreater(distance2, lanesLoad(&candidateRadius[i]))) & fullMask;
+				for (int lane = 0; bits != 0; lane++, bits >>= 1) {
+					if (bits & 1)
+						indices.push_back(candidates[i + lane]);
+				}
+			}
+			range.y = (GLuint)indices.size() - range.x;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include "WorkerPool.h"
+
+//Shader storage bindings of the buffers in shaders/clusters.glsl
+const GLuint CLUSTER_LIGHTS_BINDING = 1;
+const GLuint CLUSTER_RANGES_BINDING = 2;
+const GLuint CLUSTER_INDICES_BINDING = 3;
+
+//Small unshadowed point light, any number of them. std430 mirror of ClusterLight in shaders/clusters.glsl
+struct ClusterLight {
+	glm::vec3 position;
+	float radius;
+	glm::vec3 color;
+	float intensity;
+};
+static_assert(sizeof(ClusterLight) == 32, "ClusterLight has to match the std430 layout");
+
+/// <summary>
+/// Clustered forward lighting: the view frustum is cut into CLUSTERS_X * CLUSTERS_Y screen tiles and CLUSTERS_Z
+/// exponentially spaced depth slices. Every frame each cluster gets the list of lights whose sphere touches its
+/// view space bounds, so a fragment only walks the lights near it. Slices are assigned in parallel, lights tested
+/// a few at a time with the lanes in Lanes.h. Each slice first keeps the lights overlapping its depth range,
+/// then its clusters only test those.
+/// </summary>
+class LightClusters
+{
+public:
+	static const int CLUSTERS_X = 16;
+	static const int CLUSTERS_Y = 9;
+	static const int CLUSTERS_Z = 24;
+	static const int NUM_CLUSTERS = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+	//Depth slices go from nearPlane to farPlane, fragments outside fall in the first or last one.
+	//numThreads 0 uses every hardware thread
+	LightClusters(float nearPlane, float farPlane, int numThreads = 0);
+	~LightClusters();
+	//Assigns the lights to the clusters of a perspective camera and uploads everything. fovY in degrees
+	void update(const std::vector<ClusterLight>& lights, const glm::mat4& view, float fovY, float aspectRatio);
+	//Only uploads the lights, for passes that cull them some other way (the deferred path's tiles)
+	void uploadLights(const std::vector<ClusterLight>& lights);
+	//Slice of a view depth d is floor(log(d) * scale + bias)
+	inline float getDepthScale()const { return mDepthScale; }
+	inline float getDepthBias()const { return mDepthBias; }
+
+	//Stats of the last update
+	inline double getMilliseconds()const { return mMilliseconds; }
+	inline int getNumIndices()const { return (int)mIndices.size(); }
+	inline int getMaxLightsPerCluster()const { return mMaxLightsPerCluster; }
+	//Over clusters with at least one light
+	inline float getAverageLightsPerCluster()const { return mAverageLightsPerCluster; }
+	inline int getNumThreads()const { return mWorkers.getNumThreads(); }
+private:
+	LightClusters(const LightClusters& r) = delete;
+	void assignSlice(int slice, float tanHalfFovX, float tanHalfFovY);
+
+	float mNearPlane;
+	float mFarPlane;
+	float mDepthScale;
+	float mDepthBias;
+	WorkerPool mWorkers;
+	GLuint mBuffers[3];		//Lights, ranges, indices
+	//View space lights, structure of arrays padded to a whole number of lanes
+	std::vector<float> mViewX, mViewY, mViewZ, mRadius;
+	int mNumLights;
+	std::vector<glm::uvec2> mRanges;			//Offset into mIndices and count, per cluster
+	std::vector<GLuint> mSliceIndices[CLUSTERS_Z];	//Offsets in mRanges are relative to their slice's list until merged
+	std::vector<GLuint> mIndices;
+	double mMilliseconds;
+	int mMaxLightsPerCluster;
+	float mAverageLightsPerCluster;
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <glm/glm.hpp>
+
+const int MAX_LIGHTS = 8;
+
+struct PointLight {
+	float radius;
+	glm::vec3 position;
+	glm::vec3 color;
+	float intensity;
+	int isOn;
+	int shadowProjection;	//ShadowProjection, cheaper projections for distant or minor lights
+};
+
+struct DirectionLight {
+	glm::vec3 direction;
+	float intensity;
+	glm::vec3 color;
+	int isOn;
+};
+
+struct SpotLight {
+	float radius;
+	glm::vec3 direction;
+	float intensity;
+	glm::vec3 color;
+	glm::vec3 position;
+	float minAngle;
+	float maxAngle;
+	int isOn;
+};
+
+struct Material {
+	glm::vec3 color;
+	float ambientK;
+	float diffuseK;
+	float specularK;
+	float shininess;
+};
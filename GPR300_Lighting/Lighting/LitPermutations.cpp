@@ -0,0 +1,23 @@
+#include "LitPermutations.h"
+
+unsigned int litLightFeatures(const glm::ivec4& lightCounts, bool shadows)
+{
+	unsigned int features = (lightCounts.x << LIT_POINT_LIGHT_SHIFT) | (lightCounts.y << LIT_DIR_LIGHT_SHIFT) | (lightCounts.z << LIT_SPOT_LIGHT_SHIFT);
+	if (shadows)
+		features |= LIT_SHADOWS;
+	return features;
+}
+
+std::string litDefines(unsigned int features)
+{
+	std::string defines = "#define LIT_PERMUTATION\n";
+	defines += "#define NUM_POINT_LIGHTS " + std::to_string((features >> LIT_POINT_LIGHT_SHIFT) & 0xF) + "\n";
+	defines += "#define NUM_DIR_LIGHTS " + std::to_string((features >> LIT_DIR_LIGHT_SHIFT) & 0xF) + "\n";
+	defines += "#define NUM_SPOT_LIGHTS " + std::to_string((features >> LIT_SPOT_LIGHT_SHIFT) & 0xF) + "\n";
+	defines += std::string("#define USE_SHADOWS ") + ((features & LIT_SHADOWS) ? "1" : "0") + "\n";
+	defines += std::string("#define USE_NORMAL_MAP ") + ((features & LIT_NORMAL_MAP) ? "1" : "0") + "\n";
+	defines += std::string("#define USE_FLOOR_TEXTURE ") + ((features & LIT_FLOOR_TEXTURE) ? "1" : "0") + "\n";
+	defines += std::string("#define USE_CLUSTERED_LIGHTS ") + ((features & LIT_CLUSTERED_LIGHTS) ? "1" : "0") + "\n";
+	defines += std::string("#define USE_INSTANCING ") + ((features & LIT_INSTANCED) ? "1" : "0") + "\n";
+	return defines;
+}
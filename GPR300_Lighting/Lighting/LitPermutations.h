@@ -0,0 +1,19 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+
+//Feature bits of the defaultLit.frag variants. Each light count takes 4 bits and goes from 0 to MAX_LIGHTS
+const unsigned int LIT_POINT_LIGHT_SHIFT = 0;
+const unsigned int LIT_DIR_LIGHT_SHIFT = 4;
+const unsigned int LIT_SPOT_LIGHT_SHIFT = 8;
+const unsigned int LIT_SHADOWS = 1 << 12;
+const unsigned int LIT_NORMAL_MAP = 1 << 13;
+const unsigned int LIT_FLOOR_TEXTURE = 1 << 14;	//_FloorTexture instead of _ObjectTexture
+const unsigned int LIT_CLUSTERED_LIGHTS = 1 << 15;	//Also walks the lights in LightClusters
+const unsigned int LIT_INSTANCED = 1 << 16;	//Model and normal matrices come from InstanceBatches' instance attributes
+
+//Light counts are LightBuffer::getLightCounts()
+unsigned int litLightFeatures(const glm::ivec4& lightCounts, bool shadows);
+
+//ShaderPermutations::DefineBuilder for defaultLit
+std::string litDefines(unsigned int features);
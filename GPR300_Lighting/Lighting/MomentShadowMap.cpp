@@ -0,0 +1,181 @@
+#include "MomentShadowMap.h"
+#include <stdio.h>
+
+//Moments of the far plane (distance 1), what empty texels should read as
+static void getClearMoments(ShadowFilter filter, float clearValue[4]) {
+	switch (filter) {
+	case SHADOW_FILTER_ESM:
+		//exp(ESM_EXPONENT) with the exponent used in defaultLit.frag and depthShaderMoments.frag
+		clearValue[0] = 5.54062238e34f;
+		clearValue[1] = clearValue[2] = clearValue[3] = 0.0f;
+		break;
+	case SHADOW_FILTER_MSM:
+		//Depth 1 after the 16 bit optimized moment transform
+		clearValue[0] = 1.0f;
+		clearValue[1] = 0.99755993f;
+		clearValue[2] = 0.89343751f;
+		clearValue[3] = 0.0f;
+		break;
+	default:
+		clearValue[0] = clearValue[1] = 1.0f;
+		clearValue[2] = clearValue[3] = 0.0f;
+		break;
+	}
+}
+
+static GLenum getMomentFormat(ShadowFilter filter) {
+	switch (filter) {
+	case SHADOW_FILTER_ESM:
+		return GL_R32F;
+	case SHADOW_FILTER_MSM:
+		return GL_RGBA16F;
+	default:
+		return GL_RG32F;
+	}
+}
+
+MomentShadowMap::MomentShadowMap(int resolution, int numLights)
+	: mFilter(SHADOW_FILTER_PCF), mMoments(0), mMomentsView(0), mBlurTemp(0), mDepth(0),
+	mResolution(resolution), mNumLights(numLights), mNumMips(1)
+{
+	glGenFramebuffers(1, &mFBO);
+	glGenFramebuffers(1, &mBlurFBO);
+	while ((mResolution >> mNumMips) > 0)
+		mNumMips++;
+}
+
+MomentShadowMap::~MomentShadowMap()
+{
+	release();
+	glDeleteFramebuffers(1, &mFBO);
+	glDeleteFramebuffers(1, &mBlurFBO);
+}
+
+void MomentShadowMap::release()
+{
+	if (mMoments == 0)
+		return;
+	glDeleteTextures(1, &mMomentsView);
+	glDeleteTextures(1, &mMoments);
+	glDeleteTextures(1, &mBlurTemp);
+	glDeleteTextures(1, &mDepth);
+	mMoments = mMomentsView = mBlurTemp = mDepth = 0;
+}
+
+void MomentShadowMap::setFilter(ShadowFilter filter)
+{
+	if (filter == mFilter && mMoments != 0)
+		return;
+	release();
+	mFilter = filter;
+	GLenum format = getMomentFormat(filter);
+	int numLayers = mNumLights * 6;
+
+	//Immutable storage so the blur can read it through a 2D array view
+	glGenTextures(1, &mMoments);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mMoments);
+	glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, mNumMips, format, mResolution, mResolution, numLayers);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	glGenTextures(1, &mMomentsView);
+	glTextureView(mMomentsView, GL_TEXTURE_2D_ARRAY, mMoments, format, 0, 1, 0, numLayers);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mMomentsView);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &mBlurTemp);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mBlurTemp);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, format, mResolution, mResolution, numLayers);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &mDepth);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mDepth);
+	glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, mResolution, mResolution, numLayers);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mMoments, 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mDepth, 0);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Error loading Moment Shadow Map FBO");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (int i = 0; i < numLayers; i++)
+		clearFace(i / 6, i % 6);
+}
+
+void MomentShadowMap::bindForWriting()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glViewport(0, 0, mResolution, mResolution);
+	//Alpha is a moment (or unused 0), blending would mix it with the clear value. blurFaces turns it back on
+	glDisable(GL_BLEND);
+}
+
+void MomentShadowMap::clearFace(int light, int face)
+{
+	float clearValue[4];
+	getClearMoments(mFilter, clearValue);
+	const float farDepth = 1.0f;
+	int layer = light * 6 + face;
+	glClearTexSubImage(mMoments, 0, 0, 0, layer, mResolution, mResolution, 1, GL_RGBA, GL_FLOAT, clearValue);
+	glClearTexSubImage(mDepth, 0, 0, 0, layer, mResolution, mResolution, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+}
+
+void MomentShadowMap::blurFaces(const int faceMasks[], Shader& blurShader, ew::Mesh& fullscreenQuad)
+{
+	bool anyBlurred = false;
+	glBindFramebuffer(GL_FRAMEBUFFER, mBlurFBO);
+	glViewport(0, 0, mResolution, mResolution);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glDisable(GL_CULL_FACE);
+	blurShader.use();
+	blurShader.setInt("_Source", 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	for (int light = 0; light < mNumLights; light++) {
+		for (int face = 0; face < 6; face++) {
+			if ((faceMasks[light] & (1 << face)) == 0)
+				continue;
+			int layer = light * 6 + face;
+			blurShader.setInt("_Layer", layer);
+
+			//Horizontal: moments -> temp
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mBlurTemp, 0, layer);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, mMomentsView);
+			blurShader.setVec2("_Direction", glm::vec2(1, 0));
+			fullscreenQuad.draw();
+
+			//Vertical: temp -> moments
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mMoments, 0, layer);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, mBlurTemp);
+			blurShader.setVec2("_Direction", glm::vec2(0, 1));
+			fullscreenQuad.draw();
+			anyBlurred = true;
+		}
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glEnable(GL_CULL_FACE);
+
+	if (anyBlurred) {
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mMoments);
+		glGenerateMipmap(GL_TEXTURE_CUBE_MAP_ARRAY);
+	}
+}
+
+void MomentShadowMap::bindTexture(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mMoments);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "GL/glew.h"
+#include "PointShadowMap.h"
+#include "../EW/Shader.h"
+#include "../EW/Mesh.h"
+
+/// <summary>
+/// Filterable point shadows: a mipmapped cubemap array of depth moments (VSM, ESM or MSM), one cube per light.
+/// Faces are rendered like PointShadowMap, then blurred separably per face so lookups need a single filtered fetch.
+/// </summary>
+class MomentShadowMap
+{
+public:
+	MomentShadowMap(int resolution, int numLights);
+	~MomentShadowMap();
+	//Reallocates storage in the format the filter needs, does nothing if it already matches
+	void setFilter(ShadowFilter filter);
+	//Also disables blending until blurFaces
+	void bindForWriting();
+	void clearFace(int light, int face);
+	//Separable gaussian blur of the faces in faceMasks, then rebuilds the mip chain
+	void blurFaces(const int faceMasks[], Shader& blurShader, ew::Mesh& fullscreenQuad);
+	void bindTexture(GLenum textureUnit);
+	inline int getResolution()const { return mResolution; }
+private:
+	MomentShadowMap(const MomentShadowMap& r) = delete;
+	void release();
+	ShadowFilter mFilter;
+	GLuint mMoments;		//Cube map array, sampled by the lit shader
+	GLuint mMomentsView;	//2D array view of mMoments for the blur
+	GLuint mBlurTemp;		//2D array holding the horizontal blur result
+	GLuint mDepth;			//Depth test while rendering moments
+	GLuint mFBO;
+	GLuint mBlurFBO;
+	int mResolution;
+	int mNumLights;
+	int mNumMips;
+};
@@ -0,0 +1,206 @@
+#include "PointShadowMap.h"
+#include <stdio.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+const float PointShadowMap::TETRAHEDRON_FOV = 143.98f;
+
+//Normals of a regular tetrahedron, same order as tetrahedronNormals in defaultLit.frag
+static const glm::vec3 TETRAHEDRON_NORMALS[4] = {
+	glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(1.0f, -1.0f, -1.0f), glm::vec3(-1.0f, 1.0f, -1.0f), glm::vec3(-1.0f, -1.0f, 1.0f)
+};
+
+PointShadowMap::PointShadowMap(int resolution, int numLights)
+	: mStaticTexture(0), mStaticFBO(0), mResolution(resolution), mNumLights(numLights)
+{
+	glGenTextures(1, &mTexture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mTexture);
+	glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, mResolution, mResolution, mNumLights * 6);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+	//Faces that aren't cube faces are sampled as plain 2D layers
+	glGenTextures(1, &mLayerView);
+	glTextureView(mLayerView, GL_TEXTURE_2D_ARRAY, mTexture, GL_DEPTH_COMPONENT32F, 0, 1, 0, mNumLights * 6);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mLayerView);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	//Attaching the whole array makes the framebuffer layered
+	glGenFramebuffers(1, &mFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Error loading Point Shadow Map FBO");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	//Same texture read as projected depth, compared and bilinearly filtered by the hardware
+	glGenSamplers(1, &mCompareSampler);
+	glSamplerParameteri(mCompareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(mCompareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(mCompareSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(mCompareSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(mCompareSampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(mCompareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(mCompareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+}
+
+PointShadowMap::~PointShadowMap()
+{
+	glDeleteSamplers(1, &mCompareSampler);
+	glDeleteFramebuffers(1, &mStaticFBO);
+	glDeleteTextures(1, &mStaticTexture);
+	glDeleteFramebuffers(1, &mFBO);
+	glDeleteTextures(1, &mLayerView);
+	glDeleteTextures(1, &mTexture);
+}
+
+void PointShadowMap::bindForWriting()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glViewport(0, 0, mResolution, mResolution);
+}
+
+void PointShadowMap::clearFace(int light, int face)
+{
+	const float farDepth = 1.0f;
+	glClearTexSubImage(mTexture, 0, 0, 0, light * 6 + face, mResolution, mResolution, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+}
+
+void PointShadowMap::bindTexture(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mTexture);
+}
+
+void PointShadowMap::bindCompareTexture(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mTexture);
+	glBindSampler(textureUnit - GL_TEXTURE0, mCompareSampler);
+}
+
+void PointShadowMap::bindLayerTexture(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mLayerView);
+}
+
+void PointShadowMap::bindStaticForWriting()
+{
+	if (mStaticTexture == 0) {
+		glGenTextures(1, &mStaticTexture);
+		glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, mStaticTexture);
+		glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT32F, mResolution, mResolution, mNumLights * 6);
+
+		glGenFramebuffers(1, &mStaticFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, mStaticFBO);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mStaticTexture, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("Error loading Static Point Shadow Map FBO");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, mStaticFBO);
+	glViewport(0, 0, mResolution, mResolution);
+}
+
+void PointShadowMap::clearStaticFace(int light, int face)
+{
+	const float farDepth = 1.0f;
+	glClearTexSubImage(mStaticTexture, 0, 0, 0, light * 6 + face, mResolution, mResolution, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+}
+
+void PointShadowMap::restoreStaticFace(int light, int face)
+{
+	int layer = light * 6 + face;
+	glCopyImageSubData(mStaticTexture, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layer,
+		mTexture, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, layer, mResolution, mResolution, 1);
+}
+
+void PointShadowMap::uploadFace(int light, int face, const float* distances)
+{
+	glTextureSubImage3D(mTexture, 0, 0, 0, light * 6 + face, mResolution, mResolution, 1, GL_DEPTH_COMPONENT, GL_FLOAT, distances);
+}
+
+void PointShadowMap::readFace(int light, int face, float* distances)
+{
+	glGetTextureSubImage(mTexture, 0, 0, 0, light * 6 + face, mResolution, mResolution, 1, GL_DEPTH_COMPONENT, GL_FLOAT,
+		mResolution * mResolution * sizeof(float), distances);
+}
+
+void PointShadowMap::getFaceMatrices(const glm::vec3& lightPos, float nearPlane, float farPlane, glm::mat4 faceMatrices[6])
+{
+	glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane);
+
+	faceMatrices[0] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0));
+	faceMatrices[1] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0));
+	faceMatrices[2] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0));
+	faceMatrices[3] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0));
+	faceMatrices[4] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0));
+	faceMatrices[5] = shadowProj * glm::lookAt(lightPos, lightPos + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0));
+}
+
+void PointShadowMap::getTetrahedronMatrices(const glm::vec3& lightPos, float nearPlane, float farPlane, glm::mat4 faceMatrices[4])
+{
+	glm::mat4 shadowProj = glm::perspective(glm::radians(TETRAHEDRON_FOV), 1.0f, nearPlane, farPlane);
+
+	//None of the normals are parallel to Y, so it works as the up vector for all of them
+	for (int face = 0; face < 4; face++) {
+		faceMatrices[face] = shadowProj * glm::lookAt(lightPos, lightPos + TETRAHEDRON_NORMALS[face], glm::vec3(0.0, 1.0, 0.0));
+	}
+}
+
+int PointShadowMap::getProjectionFaceMask(ShadowProjection projection)
+{
+	switch (projection) {
+	case SHADOW_PROJECTION_TETRAHEDRON:
+		return 0x0F;
+	case SHADOW_PROJECTION_DUAL_PARABOLOID:
+		return 0x03;
+	default:
+		return 0x3F;
+	}
+}
+
+float PointShadowMap::getMinTexelsPerDegree(ShadowProjection projection, int resolution)
+{
+	//Perspective faces are sparsest at their center, a paraboloid is too, at half the density of its rim
+	float texelsPerRadian;
+	switch (projection) {
+	case SHADOW_PROJECTION_TETRAHEDRON:
+		texelsPerRadian = resolution * 0.5f / tanf(glm::radians(TETRAHEDRON_FOV) * 0.5f);
+		break;
+	case SHADOW_PROJECTION_DUAL_PARABOLOID:
+		texelsPerRadian = resolution * 0.25f;
+		break;
+	default:
+		texelsPerRadian = resolution * 0.5f;
+		break;
+	}
+	return texelsPerRadian * 3.14159265f / 180.0f;
+}
+
+float PointShadowMap::getNearPlaneScale(ShadowProjection projection)
+{
+	switch (projection) {
+	case SHADOW_PROJECTION_TETRAHEDRON: {
+		float tanHalfFov = tanf(glm::radians(TETRAHEDRON_FOV) * 0.5f);
+		return 1.0f / sqrtf(1.0f + 2.0f * tanHalfFov * tanHalfFov);
+	}
+	case SHADOW_PROJECTION_DUAL_PARABOLOID:
+		return 1.0f;
+	default:
+		return 0.57735027f; //1 / sqrt(3), a cube face corner
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+
+//How the lit shader filters point shadows, matches the SHADOW_FILTER_* defines in defaultLit.frag
+enum ShadowFilter {
+	SHADOW_FILTER_PCF = 0,
+	SHADOW_FILTER_HARDWARE_PCF,
+	SHADOW_FILTER_VSM,
+	SHADOW_FILTER_ESM,
+	SHADOW_FILTER_MSM
+};
+
+//How a point light's surroundings are split into faces, matches the SHADOW_PROJECTION_* defines in defaultLit.frag
+enum ShadowProjection {
+	SHADOW_PROJECTION_CUBE = 0,			//6 faces, 90 degree perspective
+	SHADOW_PROJECTION_TETRAHEDRON,		//4 faces, 144 degree perspective
+	SHADOW_PROJECTION_DUAL_PARABOLOID	//2 faces, each a paraboloid mapped hemisphere
+};
+
+/// <summary>
+/// Depth cubemap array holding one cube (6 layers) per point light.
+/// Layer (light * 6 + face) is selected with gl_Layer so every light is rendered in one layered draw.
+/// Faces are cleared individually so unchanged faces can be kept from previous frames.
+/// Tetrahedron and paraboloid lights use the first 4 or 2 layers of their cube, read through a 2D array view.
+/// An optional second array caches only the static casters, redrawn faces start as a copy of it.
+/// </summary>
+class PointShadowMap
+{
+public:
+	PointShadowMap(int resolution, int numLights);
+	~PointShadowMap();
+	void bindForWriting();
+	void clearFace(int light, int face);
+	void bindTexture(GLenum textureUnit);
+	//Binds with a depth compare sampler for samplerCubeArrayShadow lookups (hardware PCF)
+	void bindCompareTexture(GLenum textureUnit);
+	//Binds the same layers as a sampler2DArray, for the tetrahedron and paraboloid lookups
+	void bindLayerTexture(GLenum textureUnit);
+	//Static caster cache, allocated the first time it is used
+	void bindStaticForWriting();
+	void clearStaticFace(int light, int face);
+	//Copies the static face into the working face, replaces clearFace when only dynamic casters are drawn on top
+	void restoreStaticFace(int light, int face);
+	//Distances written or rendered on the CPU, resolution * resolution floats with rows bottom to top
+	void uploadFace(int light, int face, const float* distances);
+	void readFace(int light, int face, float* distances);
+	inline int getResolution()const { return mResolution; }
+	inline int getNumLights()const { return mNumLights; }
+
+	//Fills faceMatrices with the view projection for each cube face, in GL_TEXTURE_CUBE_MAP_POSITIVE_X order
+	static void getFaceMatrices(const glm::vec3& lightPos, float nearPlane, float farPlane, glm::mat4 faceMatrices[6]);
+	//Same for the 4 faces of the tetrahedron projection, face i looks along the i-th tetrahedron normal
+	static void getTetrahedronMatrices(const glm::vec3& lightPos, float nearPlane, float farPlane, glm::mat4 faceMatrices[4]);
+	//Layers of the light's cube a projection renders to
+	static int getProjectionFaceMask(ShadowProjection projection);
+	//Lowest angular resolution anywhere on a face, to compare the quality of the projections
+	static float getMinTexelsPerDegree(ShadowProjection projection, int resolution);
+	//Near plane as a fraction of the distance to the closest caster, so no part of that caster is in front of it.
+	//Frustum corners are further off axis than the face center, a paraboloid has no near plane to clip against
+	static float getNearPlaneScale(ShadowProjection projection);
+
+	//Wide enough that the square frustum covers every direction nearest to its tetrahedron normal
+	static const float TETRAHEDRON_FOV;
+private:
+	PointShadowMap(const PointShadowMap& r) = delete;
+	GLuint mTexture;
+	GLuint mLayerView;
+	GLuint mFBO;
+	GLuint mCompareSampler;
+	GLuint mStaticTexture;
+	GLuint mStaticFBO;
+	int mResolution;
+	int mNumLights;
+};
@@ -0,0 +1,212 @@
+#include "ShadowAtlas.h"
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include <glm/gtc/matrix_access.hpp>
+
+//Largest power of two square of 32 bit depth that fits in the budget
+static int atlasSizeForBudget(int budgetMB) {
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	long long budgetBytes = (long long)budgetMB * 1024 * 1024;
+	int size = ShadowAtlas::MAX_FACE_SIZE;
+	while ((long long)(size * 2) * (size * 2) * 4 <= budgetBytes && size * 2 <= maxSize)
+		size *= 2;
+	return size;
+}
+
+//Conservative test of a box against the camera frustum planes (Gribb & Hartmann)
+static bool boxInFrustum(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4& viewProj) {
+	glm::vec4 rows[4] = { glm::row(viewProj, 0), glm::row(viewProj, 1), glm::row(viewProj, 2), glm::row(viewProj, 3) };
+	for (int i = 0; i < 6; i++) {
+		glm::vec4 plane = (i % 2 == 0) ? rows[3] + rows[i / 2] : rows[3] - rows[i / 2];
+		glm::vec3 p(
+			plane.x >= 0.0f ? boxMax.x : boxMin.x,
+			plane.y >= 0.0f ? boxMax.y : boxMin.y,
+			plane.z >= 0.0f ? boxMax.z : boxMin.z);
+		if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+ShadowAtlas::ShadowAtlas(int budgetMB)
+	: mTexture(0), mSize(atlasSizeForBudget(budgetMB)), mUsedTexels(0)
+{
+	glGenFramebuffers(1, &mFBO);
+	for (int i = 0; i < MAX_LIGHTS * 6; i++)
+		mRects[i] = { 0, 0, 0 };
+	allocate();
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+	glDeleteFramebuffers(1, &mFBO);
+	glDeleteTextures(1, &mTexture);
+}
+
+void ShadowAtlas::allocate()
+{
+	glDeleteTextures(1, &mTexture);
+	glGenTextures(1, &mTexture);
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, mSize, mSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Error loading Shadow Atlas FBO");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (int i = 0; i < MAX_LIGHTS * 6; i++)
+		mRects[i] = { 0, 0, 0 };
+}
+
+bool ShadowAtlas::setBudget(int budgetMB)
+{
+	int size = atlasSizeForBudget(budgetMB);
+	if (size == mSize)
+		return false;
+	mSize = size;
+	allocate();
+	return true;
+}
+
+void ShadowAtlas::pack(const PointLight lights[MAX_LIGHTS], const glm::mat4& viewProj, const glm::vec3& camPos, float pixelsPerRadian, int changedFaceMasks[MAX_LIGHTS])
+{
+	struct FaceRequest {
+		int layer;
+		int size;
+		float importance;
+	};
+	std::vector<FaceRequest> requests;
+
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		if (lights[i].isOn != 1)
+			continue;
+
+		//Angle the light's sphere covers on screen, in pixels. Nearer, bigger and brighter lights matter more
+		float distance = glm::length(lights[i].position - camPos);
+		float radius = glm::max(lights[i].radius, 0.01f);
+		float angularRadius = distance > radius ? asinf(radius / distance) : 1.5707963f;
+		float coverage = angularRadius * pixelsPerRadian;
+		float importance = coverage * glm::max(lights[i].intensity, 0.01f);
+
+		int lightSize = MIN_FACE_SIZE;
+		while (lightSize < MAX_FACE_SIZE && lightSize < coverage)
+			lightSize *= 2;
+
+		for (int face = 0; face < 6; face++) {
+			//Faces that can't reach anything the camera sees only need a placeholder
+			int axis = face / 2;
+			float sign = (face % 2 == 0) ? 1.0f : -1.0f;
+			glm::vec3 regionMin = lights[i].position - glm::vec3(radius);
+			glm::vec3 regionMax = lights[i].position + glm::vec3(radius);
+			if (sign > 0.0f)
+				regionMin[axis] = lights[i].position[axis];
+			else
+				regionMax[axis] = lights[i].position[axis];
+			bool visible = boxInFrustum(regionMin, regionMax, viewProj);
+
+			requests.push_back({ i * 6 + face, visible ? lightSize : MIN_FACE_SIZE, visible ? importance : 0.0f });
+		}
+	}
+
+	//Over budget: keep halving whichever face spends the most texels per unit of importance
+	long long atlasArea = (long long)mSize * mSize;
+	long long usedArea = 0;
+	for (const FaceRequest& request : requests)
+		usedArea += (long long)request.size * request.size;
+	while (usedArea > atlasArea) {
+		FaceRequest* worst = nullptr;
+		float worstCost = -1.0f;
+		for (FaceRequest& request : requests) {
+			if (request.size <= MIN_FACE_SIZE)
+				continue;
+			float cost = (float)request.size * request.size / (request.importance + 1.0f);
+			if (cost > worstCost) {
+				worstCost = cost;
+				worst = &request;
+			}
+		}
+		if (worst == nullptr)
+			break;
+		usedArea -= (long long)worst->size * worst->size * 3 / 4;
+		worst->size /= 2;
+	}
+
+	//Biggest first into a quadtree of free squares, power of two sizes so this can't fragment
+	std::stable_sort(requests.begin(), requests.end(), [](const FaceRequest& a, const FaceRequest& b) { return a.size > b.size; });
+	std::vector<AtlasRect> freeRects;
+	freeRects.push_back({ 0, 0, mSize });
+	AtlasRect newRects[MAX_LIGHTS * 6];
+	for (int i = 0; i < MAX_LIGHTS * 6; i++)
+		newRects[i] = { 0, 0, 0 };
+
+	mUsedTexels = 0;
+	for (const FaceRequest& request : requests) {
+		int best = -1;
+		for (size_t r = 0; r < freeRects.size(); r++) {
+			if (freeRects[r].size >= request.size && (best < 0 || freeRects[r].size < freeRects[best].size))
+				best = (int)r;
+		}
+		if (best < 0)
+			continue;
+
+		AtlasRect rect = freeRects[best];
+		freeRects.erase(freeRects.begin() + best);
+		while (rect.size > request.size) {
+			int half = rect.size / 2;
+			freeRects.push_back({ rect.x + half, rect.y, half });
+			freeRects.push_back({ rect.x, rect.y + half, half });
+			freeRects.push_back({ rect.x + half, rect.y + half, half });
+			rect.size = half;
+		}
+		newRects[request.layer] = rect;
+		mUsedTexels += rect.size * rect.size;
+	}
+
+	for (int layer = 0; layer < MAX_LIGHTS * 6; layer++) {
+		const AtlasRect& a = mRects[layer];
+		const AtlasRect& b = newRects[layer];
+		if (a.x != b.x || a.y != b.y || a.size != b.size)
+			changedFaceMasks[layer / 6] |= 1 << (layer % 6);
+		mRects[layer] = b;
+	}
+}
+
+void ShadowAtlas::bindForWriting()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glViewport(0, 0, mSize, mSize);
+}
+
+void ShadowAtlas::clearFace(int light, int face)
+{
+	const AtlasRect& rect = getRect(light, face);
+	if (rect.size == 0)
+		return;
+	const float farDepth = 1.0f;
+	glClearTexSubImage(mTexture, 0, rect.x, rect.y, 0, rect.size, rect.size, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &farDepth);
+}
+
+void ShadowAtlas::bindTexture(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+}
+
+glm::vec4 ShadowAtlas::getRectUV(int light, int face) const
+{
+	const AtlasRect& rect = getRect(light, face);
+	return glm::vec4(rect.x, rect.y, rect.size, rect.size) / (float)mSize;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "GL/glew.h"
+#include <glm/glm.hpp>
+#include "Lights.h"
+
+struct AtlasRect {
+	int x, y;
+	int size;	//0 when the face has no space
+};
+
+/// <summary>
+/// Packs the cube faces of every active point light into one large 2D depth texture.
+/// Each face gets a power of two resolution from how much of the screen its light covers,
+/// and everything is repacked each frame inside storage sized once from a VRAM budget.
+/// </summary>
+class ShadowAtlas
+{
+public:
+	ShadowAtlas(int budgetMB);
+	~ShadowAtlas();
+	//Reallocates only if the budget gives a different atlas size, returns true if it did
+	bool setBudget(int budgetMB);
+	//Picks every face's resolution and packs them, faces whose rect changed are added to changedFaceMasks
+	void pack(const PointLight lights[MAX_LIGHTS], const glm::mat4& viewProj, const glm::vec3& camPos, float pixelsPerRadian, int changedFaceMasks[MAX_LIGHTS]);
+	void bindForWriting();
+	void clearFace(int light, int face);
+	void bindTexture(GLenum textureUnit);
+	//xy = corner, zw = size, in [0;1] atlas coordinates
+	glm::vec4 getRectUV(int light, int face)const;
+	inline const AtlasRect& getRect(int light, int face)const { return mRects[light * 6 + face]; }
+	inline int getSize()const { return mSize; }
+	inline int getUsedTexels()const { return mUsedTexels; }
+
+	static const int MIN_FACE_SIZE = 64;
+	static const int MAX_FACE_SIZE = 1024;
+private:
+	ShadowAtlas(const ShadowAtlas& r) = delete;
+	void allocate();
+	GLuint mTexture;
+	GLuint mFBO;
+	int mSize;
+	int mUsedTexels;
+	AtlasRect mRects[MAX_LIGHTS * 6];
+};
@@ -0,0 +1,66 @@
+#include "ShadowCache.h"
+
+ShadowCache::ShadowCache()
+	: mRenderedFaces(0), mSkippedFaces(0), mTotalSkippedFaces(0)
+{
+	invalidateAll();
+}
+
+void ShadowCache::invalidateAll()
+{
+	for (int i = 0; i < MAX_LIGHTS; i++)
+		mLights[i].valid = false;
+	mCasterBounds.clear();
+}
+
+void ShadowCache::update(const PointLight lights[MAX_LIGHTS], const float nearPlanes[MAX_LIGHTS], const float farPlanes[MAX_LIGHTS],
+	const std::vector<ShadowCaster>& casters, int faceMasks[MAX_LIGHTS], int staticFaceMasks[MAX_LIGHTS])
+{
+	//A different caster list means we can't tell what moved
+	bool castersChanged = mCasterBounds.size() != casters.size();
+
+	mRenderedFaces = 0;
+	mSkippedFaces = 0;
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		faceMasks[i] = 0;
+		staticFaceMasks[i] = 0;
+		if (lights[i].isOn != 1) {
+			mLights[i].valid = false;
+			continue;
+		}
+
+		LightState& state = mLights[i];
+		float farPlane = farPlanes[i];
+		bool lightChanged = !state.valid || castersChanged || state.position != lights[i].position
+			|| state.nearPlane != nearPlanes[i] || state.farPlane != farPlane;
+		if (lightChanged) {
+			faceMasks[i] = ALL_CUBE_FACES;
+			staticFaceMasks[i] = ALL_CUBE_FACES;
+		}
+		else {
+			//Both where a caster was and where it is now have to be redrawn
+			for (size_t c = 0; c < casters.size() && staticFaceMasks[i] != ALL_CUBE_FACES; c++) {
+				if (!casters[c].moved)
+					continue;
+				int moveMask = cubeFaceMask(mCasterBounds[c], lights[i].position, farPlane) | cubeFaceMask(casters[c].bounds, lights[i].position, farPlane);
+				faceMasks[i] |= moveMask;
+				if (casters[c].isStatic)
+					staticFaceMasks[i] |= moveMask;
+			}
+		}
+
+		state.position = lights[i].position;
+		state.nearPlane = nearPlanes[i];
+		state.farPlane = farPlane;
+		state.valid = true;
+
+		int rendered = countCubeFaces(faceMasks[i]);
+		mRenderedFaces += rendered;
+		mSkippedFaces += 6 - rendered;
+	}
+	mTotalSkippedFaces += mSkippedFaces;
+
+	mCasterBounds.resize(casters.size());
+	for (size_t c = 0; c < casters.size(); c++)
+		mCasterBounds[c] = casters[c].bounds;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "Lights.h"
+#include "ShadowCulling.h"
+
+/// <summary>
+/// Tracks which point light cube faces are out of date.
+/// A face is re-rendered only when its light changed or a caster moved into or out of its frustum.
+/// Static caster faces are tracked separately, they only go out of date when the light changes.
+/// </summary>
+class ShadowCache
+{
+public:
+	ShadowCache();
+	//Fills faceMasks with the faces of each light that must be re-rendered this frame,
+	//and staticFaceMasks with the ones whose static casters must be re-rendered as well
+	void update(const PointLight lights[MAX_LIGHTS], const float nearPlanes[MAX_LIGHTS], const float farPlanes[MAX_LIGHTS],
+		const std::vector<ShadowCaster>& casters, int faceMasks[MAX_LIGHTS], int staticFaceMasks[MAX_LIGHTS]);
+	void invalidateAll();
+	inline int getRenderedFaces()const { return mRenderedFaces; }
+	inline int getSkippedFaces()const { return mSkippedFaces; }
+	inline long long getTotalSkippedFaces()const { return mTotalSkippedFaces; }
+private:
+	struct LightState {
+		glm::vec3 position;
+		float nearPlane;
+		float farPlane;
+		bool valid;
+	};
+	LightState mLights[MAX_LIGHTS];
+	std::vector<ew::AABB> mCasterBounds;
+	int mRenderedFaces;
+	int mSkippedFaces;
+	long long mTotalSkippedFaces;
+};
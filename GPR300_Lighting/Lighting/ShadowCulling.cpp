@@ -0,0 +1,84 @@
+#include "ShadowCulling.h"
+#include <math.h>
+
+//Tests the box against the plane through the origin (n . p >= offset) using its most positive corner
+static bool boxInFront(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& n, float offset) {
+	glm::vec3 p(
+		n.x >= 0.0f ? boxMax.x : boxMin.x,
+		n.y >= 0.0f ? boxMax.y : boxMin.y,
+		n.z >= 0.0f ? boxMax.z : boxMin.z);
+	return glm::dot(n, p) >= offset;
+}
+
+int cubeFaceMask(const ew::AABB& worldBounds, const glm::vec3& lightPos, float farPlane)
+{
+	//Work relative to the light so every face frustum has its apex at the origin
+	glm::vec3 boxMin = worldBounds.min - lightPos;
+	glm::vec3 boxMax = worldBounds.max - lightPos;
+
+	int mask = 0;
+	for (int face = 0; face < 6; face++) {
+		int axis = face / 2;
+		float sign = (face % 2 == 0) ? 1.0f : -1.0f;
+		glm::vec3 forward(0.0f);
+		forward[axis] = sign;
+		glm::vec3 u(0.0f), v(0.0f);
+		u[(axis + 1) % 3] = 1.0f;
+		v[(axis + 2) % 3] = 1.0f;
+
+		//90 degree frustum: the four side planes are at 45 degrees to the face axis
+		if (!boxInFront(boxMin, boxMax, forward - u, 0.0f)) continue;
+		if (!boxInFront(boxMin, boxMax, forward + u, 0.0f)) continue;
+		if (!boxInFront(boxMin, boxMax, forward - v, 0.0f)) continue;
+		if (!boxInFront(boxMin, boxMax, forward + v, 0.0f)) continue;
+		if (!boxInFront(boxMin, boxMax, -forward, -farPlane)) continue;
+		mask |= 1 << face;
+	}
+	return mask;
+}
+
+int countCubeFaces(int mask)
+{
+	int count = 0;
+	for (int face = 0; face < 6; face++)
+		count += (mask >> face) & 1;
+	return count;
+}
+
+float distanceToBounds(const ew::AABB& worldBounds, const glm::vec3& point)
+{
+	glm::vec3 closest = glm::clamp(point, worldBounds.min, worldBounds.max);
+	return glm::length(point - closest);
+}
+
+float nearestCasterDistance(const std::vector<ShadowCaster>& casters, const glm::vec3& lightPos, float farPlane)
+{
+	float nearest = farPlane;
+	for (size_t c = 0; c < casters.size(); c++)
+		nearest = glm::min(nearest, distanceToBounds(casters[c].bounds, lightPos));
+	return nearest;
+}
+
+float fitShadowNearPlane(float nearestDistance, float farPlane)
+{
+	float nearPlane = glm::max(nearestDistance, MIN_SHADOW_NEAR_PLANE);
+	nearPlane = exp2f(floorf(log2f(nearPlane)));
+	return glm::clamp(nearPlane, MIN_SHADOW_NEAR_PLANE, farPlane * 0.5f);
+}
+
+void buildCasterFaceMasks(const std::vector<ShadowCaster>& casters, const PointLight lights[MAX_LIGHTS], const int lightFaceMasks[MAX_LIGHTS],
+	const float farPlanes[MAX_LIGHTS], bool cull, std::vector<int>& casterFaceMasks)
+{
+	casterFaceMasks.resize(casters.size() * MAX_LIGHTS);
+	for (size_t c = 0; c < casters.size(); c++) {
+		for (int i = 0; i < MAX_LIGHTS; i++) {
+			int mask = lightFaceMasks[i];
+			//Nothing past the far plane can cast, the light's attenuation has reached zero there
+			if (mask != 0 && distanceToBounds(casters[c].bounds, lights[i].position) > farPlanes[i])
+				mask = 0;
+			if (cull && mask != 0)
+				mask &= cubeFaceMask(casters[c].bounds, lights[i].position, farPlanes[i]);
+			casterFaceMasks[c * MAX_LIGHTS + i] = mask;
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "Lights.h"
+#include "../EW/Bounds.h"
+
+//Bit i is set for cube face i (GL_TEXTURE_CUBE_MAP_POSITIVE_X + i)
+const int ALL_CUBE_FACES = 0x3F;
+
+//Keeps depth precision sane for lights sitting right on a caster
+const float MIN_SHADOW_NEAR_PLANE = 0.05f;
+const float MIN_SHADOW_FAR_PLANE = 0.1f;
+
+struct ShadowCaster {
+	ew::AABB bounds;	//World space bounds this frame
+	bool moved;			//Transform changed since the last frame
+	bool isStatic;		//Level geometry, can live in the static shadow cache
+};
+
+//Returns a mask of the cube faces of a point light whose frustum overlaps worldBounds
+int cubeFaceMask(const ew::AABB& worldBounds, const glm::vec3& lightPos, float farPlane);
+
+int countCubeFaces(int mask);
+
+//Distance from point to the closest point of the box, 0 inside it
+float distanceToBounds(const ew::AABB& worldBounds, const glm::vec3& point);
+
+//Closest caster within farPlane of the light, farPlane if there is none
+float nearestCasterDistance(const std::vector<ShadowCaster>& casters, const glm::vec3& lightPos, float farPlane);
+
+//Rounds the near plane down to a power of two so casters moving a little don't change the projection every frame
+float fitShadowNearPlane(float nearestDistance, float farPlane);
+
+//Fills casterFaceMasks[caster * MAX_LIGHTS + light] with the faces of lightFaceMasks that each caster overlaps.
+//Casters outside a light's far plane sphere are always skipped, without culling the rest get the light's whole mask.
+void buildCasterFaceMasks(const std::vector<ShadowCaster>& casters, const PointLight lights[MAX_LIGHTS], const int lightFaceMasks[MAX_LIGHTS],
+	const float farPlanes[MAX_LIGHTS], bool cull, std::vector<int>& casterFaceMasks);
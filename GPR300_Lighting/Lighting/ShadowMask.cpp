@@ -0,0 +1,101 @@
+#include "ShadowMask.h"
+#include <stdio.h>
+
+ShadowMask::ShadowMask()
+	: mDistanceTexture(0), mDepthTexture(0), mPrepassFBO(0), mMaskTexture(0), mMaskFBO(0),
+	mWidth(0), mHeight(0), mHalfResolution(false)
+{
+}
+
+ShadowMask::~ShadowMask()
+{
+	release();
+}
+
+void ShadowMask::release()
+{
+	glDeleteFramebuffers(1, &mPrepassFBO);
+	glDeleteFramebuffers(1, &mMaskFBO);
+	glDeleteTextures(1, &mDistanceTexture);
+	glDeleteTextures(1, &mDepthTexture);
+	glDeleteTextures(1, &mMaskTexture);
+	mPrepassFBO = mMaskFBO = mDistanceTexture = mDepthTexture = mMaskTexture = 0;
+}
+
+void ShadowMask::resize(int screenWidth, int screenHeight, bool halfResolution)
+{
+	if (mPrepassFBO != 0 && (screenWidth == mWidth || screenWidth <= 0) && (screenHeight == mHeight || screenHeight <= 0) && halfResolution == mHalfResolution)
+		return;
+	release();
+	//A minimized window reports 0x0
+	mWidth = screenWidth > 0 ? screenWidth : 1;
+	mHeight = screenHeight > 0 ? screenHeight : 1;
+	mHalfResolution = halfResolution;
+
+	//Prepass: camera distance plus a depth buffer to resolve visibility
+	glGenTextures(1, &mDistanceTexture);
+	glBindTexture(GL_TEXTURE_2D, mDistanceTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, mWidth, mHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &mDepthTexture);
+	glBindTexture(GL_TEXTURE_2D, mDepthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, mWidth, mHeight);
+
+	glGenFramebuffers(1, &mPrepassFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, mPrepassFBO);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mDistanceTexture, 0);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, mDepthTexture, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Error loading Depth Prepass FBO");
+
+	//Mask: lights 0-3 in layer 0, 4-7 in layer 1, both written by one draw
+	int scale = getScale();
+	glGenTextures(1, &mMaskTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mMaskTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, (mWidth + scale - 1) / scale, (mHeight + scale - 1) / scale, 2);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenFramebuffers(1, &mMaskFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, mMaskFBO);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mMaskTexture, 0, 0);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, mMaskTexture, 0, 1);
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Error loading Shadow Mask FBO");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMask::bindPrepassForWriting()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mPrepassFBO);
+	glViewport(0, 0, mWidth, mHeight);
+	const float background[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, background);
+	glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void ShadowMask::bindMaskForWriting()
+{
+	int scale = getScale();
+	glBindFramebuffer(GL_FRAMEBUFFER, mMaskFBO);
+	glViewport(0, 0, (mWidth + scale - 1) / scale, (mHeight + scale - 1) / scale);
+}
+
+void ShadowMask::bindDistanceTexture(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D, mDistanceTexture);
+}
+
+void ShadowMask::bindMaskTexture(GLenum textureUnit)
+{
+	glActiveTexture(textureUnit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mMaskTexture);
+}
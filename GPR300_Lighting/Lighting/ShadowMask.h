@@ -0,0 +1,34 @@
+#pragma once
+#include "GL/glew.h"
+
+/// <summary>
+/// Screen-space point shadow mask. A depth prepass writes each pixel's distance from the camera,
+/// then every light's shadow is resolved once per visible pixel into a 2 layer RGBA8 array (one channel per light).
+/// The mask can be half resolution, the lit shader upsamples it using the full resolution distances.
+/// </summary>
+class ShadowMask
+{
+public:
+	ShadowMask();
+	~ShadowMask();
+	//Reallocates only when the screen size or mask resolution changed
+	void resize(int screenWidth, int screenHeight, bool halfResolution);
+	//Binds and clears the prepass target, distance 0 marks the background
+	void bindPrepassForWriting();
+	void bindMaskForWriting();
+	void bindDistanceTexture(GLenum textureUnit);
+	void bindMaskTexture(GLenum textureUnit);
+	//Full resolution pixels per mask pixel along each axis
+	inline int getScale()const { return mHalfResolution ? 2 : 1; }
+private:
+	ShadowMask(const ShadowMask& r) = delete;
+	void release();
+	GLuint mDistanceTexture;
+	GLuint mDepthTexture;
+	GLuint mPrepassFBO;
+	GLuint mMaskTexture;
+	GLuint mMaskFBO;
+	int mWidth;
+	int mHeight;
+	bool mHalfResolution;
+};
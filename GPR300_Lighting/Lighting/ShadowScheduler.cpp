@@ -0,0 +1,102 @@
+#include "ShadowScheduler.h"
+#include "ShadowCulling.h"
+#include <algorithm>
+#include <math.h>
+
+const float ShadowScheduler::FULL_RATE_IMPORTANCE = 1.0f;
+
+ShadowScheduler::ShadowScheduler()
+	: mScheduledFaces(0), mDeferredFaces(0)
+{
+	reset();
+}
+
+void ShadowScheduler::reset()
+{
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		LightSchedule& light = mLights[i];
+		light.pending = 0;
+		light.pendingStatic = 0;
+		light.nextFace = 0;
+		light.framesSinceConsidered = 0;
+		light.staleFrames = 0;
+		light.pendingFaces = 0;
+		light.interval = 0;
+		light.importance = 0.0f;
+		light.position = glm::vec3(0.0f);
+		light.wasOn = false;
+	}
+}
+
+void ShadowScheduler::schedule(const PointLight lights[MAX_LIGHTS], const glm::vec3& cameraPosition, const bool mustRender[MAX_LIGHTS],
+	int faceBudget, int faceMasks[MAX_LIGHTS], int staticFaceMasks[MAX_LIGHTS])
+{
+	int budget = faceBudget;
+	int candidates[MAX_LIGHTS];
+	int numCandidates = 0;
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		LightSchedule& light = mLights[i];
+		int outdated = faceMasks[i];
+		int outdatedStatic = staticFaceMasks[i];
+		faceMasks[i] = 0;
+		staticFaceMasks[i] = 0;
+		if (lights[i].isOn != 1) {
+			light.pending = light.pendingStatic = 0;
+			light.importance = 0.0f;
+			light.interval = 0;
+			light.wasOn = false;
+			continue;
+		}
+		light.pending |= outdated;
+		light.pendingStatic |= outdatedStatic;
+
+		//Intensity times roughly the solid angle the light's sphere covers from the camera
+		float distance = glm::distance(cameraPosition, lights[i].position);
+		light.importance = lights[i].intensity * lights[i].radius * lights[i].radius / std::max(distance * distance, 0.01f);
+
+		//The camera is inside the light's reach, or its shadows are wrong wherever they are stale
+		bool everyFrame = mustRender[i] || !light.wasOn || light.position != lights[i].position || distance < lights[i].radius;
+		light.position = lights[i].position;
+		light.wasOn = true;
+		if (everyFrame) {
+			light.interval = 0;
+			faceMasks[i] = light.pending;
+			budget -= countCubeFaces(light.pending);
+			continue;
+		}
+		light.interval = std::min(std::max((int)ceilf(FULL_RATE_IMPORTANCE / std::max(light.importance, 0.0001f)), 1), MAX_UPDATE_INTERVAL);
+		light.framesSinceConsidered++;
+		if (light.pending != 0 && light.framesSinceConsidered >= light.interval)
+			candidates[numCandidates++] = i;
+	}
+
+	//Lights waiting a long time catch up with more important ones
+	std::sort(candidates, candidates + numCandidates, [&](int a, int b) {
+		return mLights[a].importance * (1 + mLights[a].staleFrames) > mLights[b].importance * (1 + mLights[b].staleFrames);
+	});
+	for (int c = 0; c < numCandidates && budget > 0; c++) {
+		LightSchedule& light = mLights[candidates[c]];
+		light.framesSinceConsidered = 0;
+		for (int step = 0; step < 6 && budget > 0; step++) {
+			int face = (light.nextFace + step) % 6;
+			if ((light.pending & (1 << face)) == 0)
+				continue;
+			faceMasks[candidates[c]] |= 1 << face;
+			budget--;
+			light.nextFace = (face + 1) % 6;
+		}
+	}
+
+	mScheduledFaces = 0;
+	mDeferredFaces = 0;
+	for (int i = 0; i < MAX_LIGHTS; i++) {
+		LightSchedule& light = mLights[i];
+		staticFaceMasks[i] = light.pendingStatic & faceMasks[i];
+		light.pending &= ~faceMasks[i];
+		light.pendingStatic &= ~faceMasks[i];
+		light.pendingFaces = countCubeFaces(light.pending);
+		light.staleFrames = light.pending != 0 ? light.staleFrames + 1 : 0;
+		mScheduledFaces += countCubeFaces(faceMasks[i]);
+		mDeferredFaces += light.pendingFaces;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "Lights.h"
+
+/// <summary>
+/// Spreads shadow face updates over frames. Faces ShadowCache reports out of date are kept pending until they are drawn.
+/// Lights are ranked by how much of the screen they can light (intensity and radius against distance to the camera).
+/// Nearby, moving and newly switched on lights draw all their pending faces every frame; the rest share a per frame
+/// face budget, most important and most out of date first, with less important lights only considered every few frames.
+/// A light that gets part of the budget takes its pending faces round-robin, continuing where it last stopped.
+/// </summary>
+class ShadowScheduler
+{
+public:
+	//Importance at which a light is considered every frame, half of it every 2 frames and so on
+	static const float FULL_RATE_IMPORTANCE;
+	static const int MAX_UPDATE_INTERVAL = 16;
+
+	ShadowScheduler();
+	//faceMasks and staticFaceMasks come in as the faces that went out of date this frame and leave as the faces to draw.
+	//Lights in mustRender have nothing valid in their maps (new projection or near/far planes, storage changed...) and draw everything pending
+	void schedule(const PointLight lights[MAX_LIGHTS], const glm::vec3& cameraPosition, const bool mustRender[MAX_LIGHTS],
+		int faceBudget, int faceMasks[MAX_LIGHTS], int staticFaceMasks[MAX_LIGHTS]);
+	//Forgets what is pending, for when every face is about to be redrawn anyway
+	void reset();
+
+	inline float getImportance(int light)const { return mLights[light].importance; }
+	//0 when the light is drawn every frame regardless of the budget
+	inline int getUpdateInterval(int light)const { return mLights[light].interval; }
+	inline int getPendingFaces(int light)const { return mLights[light].pendingFaces; }
+	//Frames since all of the light's faces were last up to date
+	inline int getStaleFrames(int light)const { return mLights[light].staleFrames; }
+	inline int getScheduledFaces()const { return mScheduledFaces; }
+	inline int getDeferredFaces()const { return mDeferredFaces; }
+private:
+	struct LightSchedule {
+		int pending;
+		int pendingStatic;
+		int nextFace;		//Round-robin cursor
+		int framesSinceConsidered;
+		int staleFrames;
+		int pendingFaces;
+		int interval;
+		float importance;
+		glm::vec3 position;
+		bool wasOn;
+	};
+	LightSchedule mLights[MAX_LIGHTS];
+	int mScheduledFaces;
+	int mDeferredFaces;
+};
@@ -0,0 +1,287 @@
+#include "SoftwareShadowRasterizer.h"
+#include "PointShadowMap.h"
+#include "Lanes.h"
+#include <stdio.h>
+#include <chrono>
+
+struct ClipVertex {
+	glm::vec4 clip;
+	glm::vec3 relative;
+};
+
+//Keeps the part of the polygon where dot(plane, clip) >= 0, a triangle clipped by two planes has at most 5 vertices
+static int clipPolygon(const ClipVertex* in, int count, const glm::vec4& plane, ClipVertex* out) {
+	int outCount = 0;
+	for (int i = 0; i < count; i++) {
+		const ClipVertex& a = in[i];
+		const ClipVertex& b = in[(i + 1) % count];
+		float da = glm::dot(plane, a.clip);
+		float db = glm::dot(plane, b.clip);
+		if (da >= 0.0f)
+			out[outCount++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f)) {
+			float t = da / (da - db);
+			out[outCount++] = { glm::mix(a.clip, b.clip, t), glm::mix(a.relative, b.relative, t) };
+		}
+	}
+	return outCount;
+}
+
+SoftwareShadowRasterizer::SoftwareShadowRasterizer(int resolution, int numThreads)
+	: mResolution(resolution), mWorkers(numThreads), mMilliseconds(0.0), mTrianglesRendered(0)
+{
+	//Full lane blocks never cross a row or tile edge
+	if (mResolution % 8 != 0) {
+		printf("Software shadow resolution %d is not a multiple of 8", mResolution);
+		mResolution = (mResolution + 7) / 8 * 8;
+	}
+	mTilesPerRow = (mResolution + TILE_SIZE - 1) / TILE_SIZE;
+	mFaces.assign((size_t)mResolution * mResolution * 6, 1.0f);
+	for (int face = 0; face < 6; face++)
+		mTileBins[face].resize(mTilesPerRow * mTilesPerRow);
+}
+
+void SoftwareShadowRasterizer::render(const std::vector<SoftwareShadowCaster>& casters, const glm::vec3& lightPos, float nearPlane, float farPlane, int faceMask)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	//Vertices are transformed once and shared by all faces. Working relative to the light keeps them small
+	mFirstVertex.resize(casters.size());
+	size_t numVertices = 0;
+	for (size_t i = 0; i < casters.size(); i++) {
+		mFirstVertex[i] = numVertices;
+		numVertices += casters[i].mesh->vertices.size();
+	}
+	mVertices.resize(numVertices);
+	mWorkers.parallelFor((int)casters.size(), [&](int i) {
+		transformCaster(casters[i], mFirstVertex[i], lightPos);
+	});
+
+	int faces[6];
+	int numFaces = 0;
+	for (int face = 0; face < 6; face++) {
+		if (faceMask & (1 << face))
+			faces[numFaces++] = face;
+	}
+
+	glm::mat4 faceMatrices[6];
+	PointShadowMap::getFaceMatrices(glm::vec3(0.0f), nearPlane, farPlane, faceMatrices);
+	mWorkers.parallelFor(numFaces, [&](int i) {
+		setupFace(faces[i], casters, faceMatrices[faces[i]]);
+	});
+
+	int tilesPerFace = mTilesPerRow * mTilesPerRow;
+	mWorkers.parallelFor(numFaces * tilesPerFace, [&](int i) {
+		rasterizeTile(faces[i / tilesPerFace], i % tilesPerFace, farPlane);
+	});
+
+	mTrianglesRendered = 0;
+	for (int i = 0; i < numFaces; i++)
+		mTrianglesRendered += (long long)mTriangles[faces[i]].size();
+	mMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+double SoftwareShadowRasterizer::getTrianglesPerSecondPerThread()const
+{
+	if (mMilliseconds <= 0.0)
+		return 0.0;
+	return mTrianglesRendered / (mMilliseconds * 0.001) / mWorkers.getNumThreads();
+}
+
+void SoftwareShadowRasterizer::transformCaster(const SoftwareShadowCaster& caster, size_t firstVertex, const glm::vec3& lightPos)
+{
+	const std::vector<ew::Vertex>& vertices = caster.mesh->vertices;
+	for (size_t i = 0; i < vertices.size(); i++)
+		mVertices[firstVertex + i] = glm::vec3(caster.model * glm::vec4(vertices[i].position, 1.0f)) - lightPos;
+}
+
+void SoftwareShadowRasterizer::setupFace(int face, const std::vector<SoftwareShadowCaster>& casters, const glm::mat4& faceMatrix)
+{
+	mTriangles[face].clear();
+	for (std::vector<int>& bin : mTileBins[face])
+		bin.clear();
+
+	const glm::vec4 nearPlane(0.0f, 0.0f, 1.0f, 1.0f);
+	const glm::vec4 farPlane(0.0f, 0.0f, -1.0f, 1.0f);
+	for (size_t c = 0; c < casters.size(); c++) {
+		const std::vector<unsigned int>& indices = casters[c].mesh->indices;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			ClipVertex triangle[3];
+			int outside[6] = {};
+			for (int v = 0; v < 3; v++) {
+				triangle[v].relative = mVertices[mFirstVertex[c] + indices[i + v]];
+				triangle[v].clip = faceMatrix * glm::vec4(triangle[v].relative, 1.0f);
+				const glm::vec4& p = triangle[v].clip;
+				outside[0] += p.x > p.w;
+				outside[1] += p.x < -p.w;
+				outside[2] += p.y > p.w;
+				outside[3] += p.y < -p.w;
+				outside[4] += p.z < -p.w;
+				outside[5] += p.z > p.w;
+			}
+			//Entirely outside one plane of the frustum
+			if (std::max({ outside[0], outside[1], outside[2], outside[3], outside[4], outside[5] }) == 3)
+				continue;
+
+			//Only the near and far planes are clipped, the sides are handled by the bounding box
+			ClipVertex polygon[5], clipped[5];
+			int count = 3;
+			std::copy(triangle, triangle + 3, polygon);
+			if (outside[4] > 0) {
+				count = clipPolygon(polygon, count, nearPlane, clipped);
+				std::copy(clipped, clipped + count, polygon);
+			}
+			if (outside[5] > 0) {
+				count = clipPolygon(polygon, count, farPlane, clipped);
+				std::copy(clipped, clipped + count, polygon);
+			}
+			for (int v = 1; v + 1 < count; v++) {
+				glm::vec4 clip[3] = { polygon[0].clip, polygon[v].clip, polygon[v + 1].clip };
+				glm::vec3 relative[3] = { polygon[0].relative, polygon[v].relative, polygon[v + 1].relative };
+				addTriangle(face, clip, relative);
+			}
+		}
+	}
+}
+
+void SoftwareShadowRasterizer::addTriangle(int face, const glm::vec4 clip[3], const glm::vec3 relative[3])
+{
+	float sx[3], sy[3], attributes[4][3];
+	for (int v = 0; v < 3; v++) {
+		float invW = 1.0f / clip[v].w;
+		sx[v] = (clip[v].x * invW * 0.5f + 0.5f) * mResolution;
+		sy[v] = (clip[v].y * invW * 0.5f + 0.5f) * mResolution;
+		attributes[0][v] = invW;
+		attributes[1][v] = relative[v].x * invW;
+		attributes[2][v] = relative[v].y * invW;
+		attributes[3][v] = relative[v].z * invW;
+	}
+
+	//The shadow pass culls GL_FRONT, so only clockwise triangles are drawn. They are flipped to counter clockwise here
+	double area = ((double)sx[1] - sx[0]) * ((double)sy[2] - sy[0]) - ((double)sx[2] - sx[0]) * ((double)sy[1] - sy[0]);
+	if (area >= 0.0)
+		return;
+	area = -area;
+	std::swap(sx[1], sx[2]);
+	std::swap(sy[1], sy[2]);
+	for (int k = 0; k < 4; k++)
+		std::swap(attributes[k][1], attributes[k][2]);
+
+	//Texels whose centers can be inside, clamped before converting so guard band coordinates can't overflow
+	float minX = std::max(std::min({ sx[0], sx[1], sx[2] }) - 0.5f, 0.0f);
+	float minY = std::max(std::min({ sy[0], sy[1], sy[2] }) - 0.5f, 0.0f);
+	float maxX = std::min(std::max({ sx[0], sx[1], sx[2] }) - 0.5f, mResolution - 1.0f);
+	float maxY = std::min(std::max({ sy[0], sy[1], sy[2] }) - 0.5f, mResolution - 1.0f);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	RasterTriangle t;
+	t.minX = (int)ceilf(minX);
+	t.minY = (int)ceilf(minY);
+	t.maxX = (int)floorf(maxX);
+	t.maxY = (int)floorf(maxY);
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return;
+
+	//Edge i goes from vertex i to i + 1 and is positive inside, so divided by the area it is the weight of the opposite vertex.
+	//Functions are relative to the center of texel (minX, minY), which keeps them precise for large triangles
+	double originX = t.minX + 0.5;
+	double originY = t.minY + 0.5;
+	double weightX[3], weightY[3], weight0[3];
+	for (int i = 0; i < 3; i++) {
+		int a = i, b = (i + 1) % 3, opposite = (i + 2) % 3;
+		double dx = (double)sx[b] - sx[a];
+		double dy = (double)sy[b] - sy[a];
+		t.edgeA[i] = (float)-dy;
+		t.edgeB[i] = (float)dx;
+		double edgeC = dx * (originY - sy[a]) - dy * (originX - sx[a]);
+		t.edgeC[i] = (float)edgeC;
+		//Top-left rule so texels on an edge shared by two triangles are drawn once
+		t.topLeft[i] = dy < 0.0 || (dy == 0.0 && dx < 0.0);
+		weightX[opposite] = -dy / area;
+		weightY[opposite] = dx / area;
+		weight0[opposite] = edgeC / area;
+	}
+	for (int k = 0; k < 4; k++) {
+		double px = 0.0, py = 0.0, p0 = 0.0;
+		for (int v = 0; v < 3; v++) {
+			px += attributes[k][v] * weightX[v];
+			py += attributes[k][v] * weightY[v];
+			p0 += attributes[k][v] * weight0[v];
+		}
+		t.planeX[k] = (float)px;
+		t.planeY[k] = (float)py;
+		t.plane0[k] = (float)p0;
+	}
+
+	int index = (int)mTriangles[face].size();
+	mTriangles[face].push_back(t);
+	for (int tileY = t.minY / TILE_SIZE; tileY <= t.maxY / TILE_SIZE; tileY++) {
+		for (int tileX = t.minX / TILE_SIZE; tileX <= t.maxX / TILE_SIZE; tileX++)
+			mTileBins[face][tileY * mTilesPerRow + tileX].push_back(index);
+	}
+}
+
+void SoftwareShadowRasterizer::rasterizeTile(int face, int tile, float farPlane)
+{
+	int tileX0 = (tile % mTilesPerRow) * TILE_SIZE;
+	int tileY0 = (tile / mTilesPerRow) * TILE_SIZE;
+	int tileX1 = std::min(tileX0 + TILE_SIZE, mResolution);
+	int tileY1 = std::min(tileY0 + TILE_SIZE, mResolution);
+	float* faceData = &mFaces[(size_t)face * mResolution * mResolution];
+	for (int y = tileY0; y < tileY1; y++)
+		std::fill(faceData + (size_t)y * mResolution + tileX0, faceData + (size_t)y * mResolution + tileX1, 1.0f);
+
+	const Lanes zero = lanesSet(0.0f);
+	const Lanes laneIndex = lanesIndex();
+	const Lanes far = lanesSet(farPlane);
+	for (int index : mTileBins[face][tile]) {
+		const RasterTriangle& t = mTriangles[face][index];
+		//Blocks start on a multiple of the lane count, lanes outside the triangle fail the edge tests
+		int x0 = std::max(t.minX, tileX0) / LANES * LANES;
+		int x1 = std::min(t.maxX, tileX1 - 1);
+		int y0 = std::max(t.minY, tileY0);
+		int y1 = std::min(t.maxY, tileY1 - 1);
+
+		Lanes edgeA[3], topLeft[3];
+		for (int i = 0; i < 3; i++) {
+			edgeA[i] = lanesSet(t.edgeA[i]);
+			topLeft[i] = lanesMask(t.topLeft[i]);
+		}
+		Lanes planeX[4];
+		for (int k = 0; k < 4; k++)
+			planeX[k] = lanesSet(t.planeX[k]);
+
+		for (int y = y0; y <= y1; y++) {
+			float fy = (float)(y - t.minY);
+			Lanes rowEdge[3], rowPlane[4];
+			for (int i = 0; i < 3; i++)
+				rowEdge[i] = lanesSet(t.edgeB[i] * fy + t.edgeC[i]);
+			for (int k = 0; k < 4; k++)
+				rowPlane[k] = lanesSet(t.planeY[k] * fy + t.plane0[k]);
+
+			float* row = faceData + (size_t)y * mResolution;
+			for (int x = x0; x <= x1; x += LANES) {
+				Lanes fx = lanesAdd(lanesSet((float)(x - t.minX)), laneIndex);
+				Lanes inside = lanesMask(true);
+				for (int i = 0; i < 3; i++) {
+					Lanes edge = lanesAdd(lanesMul(edgeA[i], fx), rowEdge[i]);
+					inside = lanesAnd(inside, lanesOr(lanesGreater(edge, zero), lanesAnd(lanesEqual(edge, zero), topLeft[i])));
+				}
+				if (!lanesAny(inside))
+					continue;
+
+				//Perspective correct light relative position, its length is what depthShader.frag writes
+				Lanes invW = lanesAdd(lanesMul(planeX[0], fx), rowPlane[0]);
+				Lanes px = lanesAdd(lanesMul(planeX[1], fx), rowPlane[1]);
+				Lanes py = lanesAdd(lanesMul(planeX[2], fx), rowPlane[2]);
+				Lanes pz = lanesAdd(lanesMul(planeX[3], fx), rowPlane[3]);
+				Lanes lengthOverW = lanesSqrt(lanesAdd(lanesAdd(lanesMul(px, px), lanesMul(py, py)), lanesMul(pz, pz)));
+				Lanes depth = lanesDiv(lengthOverW, lanesMul(invW, far));
+
+				Lanes current = lanesLoad(row + x);
+				lanesStore(row + x, lanesSelect(inside, lanesMin(current, depth), current));
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include "../EW/Mesh.h"
+#include "WorkerPool.h"
+
+struct SoftwareShadowCaster {
+	const ew::MeshData* mesh;
+	glm::mat4 model;	//ew::Transform::getModelMatrix()
+};
+
+/// <summary>
+/// CPU version of the point shadow pass, writes the same six face distance cubemap as depthShader.*
+/// Triangles are clipped and set up per face, binned into tiles, and the tiles are rasterized
+/// in parallel, 4 (SSE2) or 8 (AVX) texels at a time. Uses no GL, so it also runs without a GPU.
+/// </summary>
+class SoftwareShadowRasterizer
+{
+public:
+	//Resolution must be a multiple of 8. numThreads 0 uses every hardware thread
+	SoftwareShadowRasterizer(int resolution, int numThreads = 0);
+	//Renders the faces in faceMask (bit i = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i), other faces keep their last contents.
+	//Like depthShader.frag each texel is the distance / farPlane of the closest back face, 1 where nothing was drawn
+	void render(const std::vector<SoftwareShadowCaster>& casters, const glm::vec3& lightPos, float nearPlane, float farPlane, int faceMask);
+	//Rows go bottom to top, the layout glTexSubImage expects
+	inline const float* getFace(int face)const { return &mFaces[(size_t)face * mResolution * mResolution]; }
+	inline int getResolution()const { return mResolution; }
+	inline int getNumThreads()const { return mWorkers.getNumThreads(); }
+	//Stats of the last render. Only triangles that survived culling and clipping and were binned for rasterization
+	//count, once for every face they were set up for
+	inline double getMilliseconds()const { return mMilliseconds; }
+	inline long long getTrianglesRendered()const { return mTrianglesRendered; }
+	//Divided by the worker threads render() ran on
+	double getTrianglesPerSecondPerThread()const;
+
+	static const int TILE_SIZE = 32;
+private:
+	//Edge functions and screen space planes of 1/w and light relative position / w, for a counter clockwise triangle
+	struct RasterTriangle {
+		float edgeA[3], edgeB[3], edgeC[3];
+		bool topLeft[3];
+		float planeX[4], planeY[4], plane0[4];
+		int minX, minY, maxX, maxY;
+	};
+	void transformCaster(const SoftwareShadowCaster& caster, size_t firstVertex, const glm::vec3& lightPos);
+	void setupFace(int face, const std::vector<SoftwareShadowCaster>& casters, const glm::mat4& faceMatrix);
+	void addTriangle(int face, const glm::vec4 clip[3], const glm::vec3 relative[3]);
+	void rasterizeTile(int face, int tile, float farPlane);
+
+	int mResolution;
+	int mTilesPerRow;
+	WorkerPool mWorkers;
+	std::vector<float> mFaces;
+	std::vector<glm::vec3> mVertices;		//Every caster's vertices relative to the light, in caster order
+	std::vector<size_t> mFirstVertex;
+	std::vector<RasterTriangle> mTriangles[6];
+	std::vector<std::vector<int>> mTileBins[6];
+	double mMilliseconds;
+	long long mTrianglesRendered;
+};
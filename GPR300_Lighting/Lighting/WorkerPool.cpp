@@ -0,0 +1,68 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int numThreads)
+	: mTask(nullptr), mNumTasks(0), mNext(0), mGeneration(0), mBusy(0), mQuit(false)
+{
+	if (numThreads <= 0)
+		numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+	for (int i = 1; i < numThreads; i++)
+		mThreads.emplace_back(&WorkerPool::workerLoop, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for (std::thread& thread : mThreads)
+		thread.join();
+}
+
+void WorkerPool::run(int numTasks, const std::function<void(int)>& task)
+{
+	//Not worth waking anyone
+	if (mThreads.empty() || numTasks <= 1) {
+		for (int i = 0; i < numTasks; i++)
+			task(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTask = &task;
+		mNumTasks = numTasks;
+		mNext = 0;
+		mBusy = (int)mThreads.size();
+		mGeneration++;
+	}
+	mWake.notify_all();
+	drain();
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [&]() { return mBusy == 0; });
+	mTask = nullptr;
+}
+
+void WorkerPool::workerLoop()
+{
+	int seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true) {
+		mWake.wait(lock, [&]() { return mQuit || mGeneration != seenGeneration; });
+		if (mQuit)
+			return;
+		seenGeneration = mGeneration;
+		lock.unlock();
+		drain();
+		lock.lock();
+		if (--mBusy == 0)
+			mDone.notify_one();
+	}
+}
+
+void WorkerPool::drain()
+{
+	for (int i = mNext++; i < mNumTasks; i = mNext++)
+		(*mTask)(i);
+}
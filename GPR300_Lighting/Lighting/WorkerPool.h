@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Threads started once and kept waiting, so a parallelFor costs a wake up instead of creating and joining threads.
+/// The calling thread works too, a pool of N threads starts N - 1. One parallelFor at a time, not reentrant.
+/// </summary>
+class WorkerPool
+{
+public:
+	//numThreads 0 uses every hardware thread
+	explicit WorkerPool(int numThreads = 0);
+	~WorkerPool();
+	//Runs task(0) to task(numTasks - 1), each thread takes the next one until none are left. Returns when all are done
+	template <typename Task>
+	void parallelFor(int numTasks, const Task& task) { run(numTasks, std::function<void(int)>(std::cref(task))); }
+	inline int getNumThreads()const { return (int)mThreads.size() + 1; }
+private:
+	WorkerPool(const WorkerPool& r) = delete;
+	void run(int numTasks, const std::function<void(int)>& task);
+	void workerLoop();
+	void drain();
+
+	std::vector<std::thread> mThreads;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	const std::function<void(int)>* mTask;
+	int mNumTasks;
+	std::atomic<int> mNext;
+	int mGeneration;	//Bumped for every parallelFor, workers wake when it changes
+	int mBusy;			//Workers still in the current parallelFor
+	bool mQuit;
+};
@@ -7,6 +7,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include <algorithm>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -16,11 +19,29 @@
 #include "imgui/imgui_impl_opengl3.h"
 
 #include "EW/Shader.h"
+#include "EW/ShaderPermutations.h"
 #include "EW/EwMath.h"
 #include "EW/Camera.h"
 #include "EW/Mesh.h"
 #include "EW/Transform.h"
 #include "EW/ShapeGen.h"
+#include "EW/GpuTimer.h"
+#include "EW/SampleCounter.h"
+#include "EW/ProgramBinaryCache.h"
+
+#include "Lighting/Lights.h"
+#include "Lighting/LightBuffer.h"
+#include "Lighting/LitPermutations.h"
+#include "Lighting/LightClusters.h"
+#include "Lighting/GBuffer.h"
+#include "Lighting/PointShadowMap.h"
+#include "Lighting/MomentShadowMap.h"
+#include "Lighting/ShadowCache.h"
+#include "Lighting/ShadowScheduler.h"
+#include "Lighting/InstanceBatches.h"
+#include "Lighting/ShadowAtlas.h"
+#include "Lighting/ShadowMask.h"
+#include "Lighting/SoftwareShadowRasterizer.h"
 
 void processInput(GLFWwindow* window);
 void resizeFrameBufferCallback(GLFWwindow* window, int width, int height);
@@ -29,7 +50,9 @@ void mouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void mousePosCallback(GLFWwindow* window, double xpos, double ypos);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 GLuint createTexture(const char* filePath);
-void drawScene(Shader& aShader);
+void drawScene(ShaderPermutations& litShaders, unsigned int features, bool normalMap, InstanceBatches* instances);
+void drawSceneDepth(Shader& aShader);
+void drawShadowCasters(Shader& aShader, const std::vector<int>& casterFaceMasks, bool vertexLayer, InstanceBatches* instances);
 
 float lastFrameTime;
 float deltaTime;
@@ -53,48 +76,14 @@ const float CAMERA_ZOOM_SPEED = 3.0f;
 Camera camera((float)SCREEN_WIDTH / (float)SCREEN_HEIGHT);
 
 bool wireFrame = false;
-const int MAX_LIGHTS = 8;
 
 glm::vec3 bgColor = glm::vec3(0);
 glm::vec3 pointLightColors[MAX_LIGHTS];
 glm::vec3 spotLightColors[MAX_LIGHTS];
 
-struct PointLight {
-	float radius;
-	glm::vec3 position;
-	glm::vec3 color;
-	float intensity;
-	int isOn;
-};
 PointLight pointLights[MAX_LIGHTS];
-
-struct DirectionLight {
-	glm::vec3 direction;
-	float intensity;
-	glm::vec3 color;
-	int isOn;
-};
 DirectionLight dirLight[MAX_LIGHTS];
-
-struct SpotLight {
-	float radius;
-	glm::vec3 direction;
-	float intensity;
-	glm::vec3 color;
-	glm::vec3 position;
-	float minAngle;
-	float maxAngle;
-	int isOn;
-};
 SpotLight spotLight[MAX_LIGHTS];
-
-struct Material {
-	glm::vec3 color;
-	float ambientK;
-	float diffuseK;
-	float specularK;
-	float shininess;
-};
 Material material;
 
 //Meshes and Transforms
@@ -111,6 +100,16 @@ ew::Transform planeTransform[2];
 ew::Transform cylinderTransform[2];
 ew::Transform quadTransform[4];
 
+//Everything drawScene draws, in draw order
+struct SceneObject {
+	ew::Mesh* mesh;
+	const ew::MeshData* meshData;	//CPU copy, for the software shadow rasterizer
+	ew::Transform* transform;
+	bool useTexture2;
+	bool isStatic;	//Never moves, its shadows can be cached apart from the dynamic casters
+};
+std::vector<SceneObject> sceneObjects;
+
 bool isRotating = false;
 float rotationAngle = 0.01;
 
@@ -176,7 +175,8 @@ int main() {
 	ImGui::StyleColorsDark();
 
 	//Used to draw shapes. This is the shader you will be completing.
-	Shader litShader("shaders/defaultLit.vert", "shaders/defaultLit.frag");
+	//One variant per light count and feature combination, see Lighting/LitPermutations.h
+	ShaderPermutations litShader("shaders/defaultLit.vert", "shaders/defaultLit.frag", litDefines);
 
 	//Used to draw light sphere
 	Shader unlitShader("shaders/defaultLit.vert", "shaders/unlit.frag");
@@ -184,6 +184,76 @@ int main() {
 	//Used for shadow mapping
 	Shader depthShader("shaders/depthShader.vert", "shaders/depthShader.geom", "shaders/depthShader.frag");
 
+	//Shadow mapping without a geometry shader, needs gl_Layer in the vertex shader
+	bool vertexLayerSupported = GLEW_ARB_shader_viewport_layer_array || GLEW_AMD_vertex_shader_layer;
+	std::unique_ptr<Shader> layeredDepthShader;
+	std::unique_ptr<Shader> layeredDepthOnlyShader;
+	std::unique_ptr<Shader> layeredMomentShader;
+	std::unique_ptr<Shader> instancedLayeredDepthShader;
+	std::unique_ptr<Shader> instancedLayeredDepthOnlyShader;
+	std::unique_ptr<Shader> instancedLayeredMomentShader;
+	//Instanced versions of the shadow programs read the model matrix, face masks or layer per instance, see Lighting/InstanceBatches.h
+	const std::string instancedDefine = "#define INSTANCED\n";
+	if (vertexLayerSupported) {
+		layeredDepthShader.reset(new Shader("shaders/depthShaderLayered.vert", "shaders/depthShader.frag"));
+		layeredDepthOnlyShader.reset(new Shader("shaders/depthShaderLayered.vert", ""));
+		layeredMomentShader.reset(new Shader("shaders/depthShaderLayered.vert", "shaders/depthShaderMoments.frag"));
+		instancedLayeredDepthShader.reset(new Shader("shaders/depthShaderLayered.vert", "", "shaders/depthShader.frag", instancedDefine));
+		instancedLayeredDepthOnlyShader.reset(new Shader("shaders/depthShaderLayered.vert", "", "", instancedDefine));
+		instancedLayeredMomentShader.reset(new Shader("shaders/depthShaderLayered.vert", "", "shaders/depthShaderMoments.frag", instancedDefine));
+	}
+
+	//Hardware compared shadows store projected depth, no fragment shader so early-Z stays on
+	Shader depthOnlyShader("shaders/depthShader.vert", "shaders/depthShader.geom", "");
+
+	//VSM/ESM/MSM write depth moments, then get blurred per face
+	Shader momentShader("shaders/depthShader.vert", "shaders/depthShader.geom", "shaders/depthShaderMoments.frag");
+	Shader momentBlurShader("shaders/postLit.vert", "shaders/momentBlur.frag");
+
+	//Depth prepass and the screen-space shadow mask resolved from it
+	Shader depthPrepassShader("shaders/depthPrepass.vert", "shaders/depthPrepass.frag");
+	//Forward path prepass into the screen's own depth buffer, no fragment shader
+	Shader screenDepthShader("shaders/depthPrepass.vert", "", "");
+	Shader shadowMaskShader("shaders/postLit.vert", "shaders/shadowMask.frag");
+
+	//Distance shadows packed into one 2D atlas, every face clipped to its own rect
+	Shader atlasDepthShader("shaders/depthShader.vert", "shaders/depthShaderAtlas.geom", "shaders/depthShader.frag");
+
+	Shader instancedDepthShader("shaders/depthShader.vert", "shaders/depthShader.geom", "shaders/depthShader.frag", instancedDefine);
+	Shader instancedDepthOnlyShader("shaders/depthShader.vert", "shaders/depthShader.geom", "", instancedDefine);
+	Shader instancedMomentShader("shaders/depthShader.vert", "shaders/depthShader.geom", "shaders/depthShaderMoments.frag", instancedDefine);
+	Shader instancedAtlasDepthShader("shaders/depthShader.vert", "shaders/depthShaderAtlas.geom", "shaders/depthShader.frag", instancedDefine);
+
+	//Tiled deferred path: G-buffer fill with the same variants as the lit shader, per tile light culling, then one fullscreen lighting pass
+	ShaderPermutations gBufferShader("shaders/defaultLit.vert", "shaders/gBuffer.frag", litDefines);
+	Shader tileCullingShader("shaders/tileLightCulling.comp");
+	Shader deferredLitShader("shaders/postLit.vert", "shaders/deferredLit.frag");
+
+	//Every program, for the uniform report
+	std::vector<Shader*> allShaders = { &unlitShader, &depthShader, &depthOnlyShader, &momentShader, &momentBlurShader,
+		&depthPrepassShader, &screenDepthShader, &shadowMaskShader, &atlasDepthShader, &tileCullingShader, &deferredLitShader,
+		&instancedDepthShader, &instancedDepthOnlyShader, &instancedMomentShader, &instancedAtlasDepthShader };
+	if (vertexLayerSupported) {
+		allShaders.push_back(layeredDepthShader.get());
+		allShaders.push_back(layeredDepthOnlyShader.get());
+		allShaders.push_back(layeredMomentShader.get());
+		allShaders.push_back(instancedLayeredDepthShader.get());
+		allShaders.push_back(instancedLayeredDepthOnlyShader.get());
+		allShaders.push_back(instancedLayeredMomentShader.get());
+	}
+
+	//[instanced][vertex layer][distance, hardware compare, moments]
+	Shader* shadowShaders[2][2][3] = {
+		{
+			{ &depthShader, &depthOnlyShader, &momentShader },
+			{ layeredDepthShader.get(), layeredDepthOnlyShader.get(), layeredMomentShader.get() }
+		},
+		{
+			{ &instancedDepthShader, &instancedDepthOnlyShader, &instancedMomentShader },
+			{ instancedLayeredDepthShader.get(), instancedLayeredDepthOnlyShader.get(), instancedLayeredMomentShader.get() }
+		}
+	};
+
 	// Setup Textures
 	GLuint floorTexture = createTexture("Textures/MetalPlates017A_2K_Color.png");
 	GLuint objectTexture = createTexture("Textures/Tiles084_2K_Color.png");
@@ -216,29 +286,23 @@ int main() {
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		printf("Error loading Depth Buffer FBO");
 
-	//Point light shadow map
-	GLuint depthCubemap;
-	glGenTextures(1, &depthCubemap);
-
+	//Point light shadow maps, one cube per light in a single cubemap array
 	const int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-	glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-	for (int i = 0; i < 6; i++)
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	GLuint depthMapFBO;
-	glGenFramebuffers(1, &depthMapFBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthCubemap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
+	PointShadowMap pointShadowMap(SHADOW_WIDTH, MAX_LIGHTS);
 
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		printf("Error loading Depth Buffer FBO");
+	//Prefiltered shadows are blurred anyway, so they get by with a much smaller map
+	const int MOMENT_SHADOW_SIZE = 256;
+	MomentShadowMap momentShadowMap(MOMENT_SHADOW_SIZE, MAX_LIGHTS);
+
+	//Atlas storage is sized once from the budget, faces are repacked inside it every frame
+	int shadowAtlasBudgetMB = 64;
+	ShadowAtlas shadowAtlas(shadowAtlasBudgetMB);
+
+	//Sized to the screen when first used
+	ShadowMask shadowMask;
+
+	//Same faces rendered on the CPU, to check the GPU pass against and as a fallback for one light
+	SoftwareShadowRasterizer softwareShadows(SHADOW_WIDTH);
 
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -253,12 +317,41 @@ int main() {
 	ew::createPlane(1.0f, 1.0f, planeMeshData);
 	ew::MeshData quadMeshData;
 	ew::createQuad(1.0f, 1.0f, quadMeshData);
+	ew::MeshData fullscreenQuadMeshData;
+	ew::createQuad(2.0f, 2.0f, fullscreenQuadMeshData);
 
 	cubeMesh.Load(&cubeMeshData);
 	sphereMesh.Load(&sphereMeshData);
 	planeMesh.Load(&planeMeshData);
 	cylinderMesh.Load(&cylinderMeshData);
 	quadMesh.Load(&quadMeshData);
+	fullscreenQuadMesh.Load(&fullscreenQuadMeshData);
+
+	for (int i = 0; i < 2; i++)
+		sceneObjects.push_back({ &cubeMesh, &cubeMeshData, &cubeTransform[i], false, false });
+	for (int i = 0; i < 2; i++)
+		sceneObjects.push_back({ &sphereMesh, &sphereMeshData, &sphereTransform[i], false, false });
+	for (int i = 0; i < 2; i++)
+		sceneObjects.push_back({ &cylinderMesh, &cylinderMeshData, &cylinderTransform[i], false, false });
+	for (int i = 0; i < 2; i++)
+		sceneObjects.push_back({ &planeMesh, &planeMeshData, &planeTransform[i], true, true });
+	for (int i = 0; i < 4; i++)
+		sceneObjects.push_back({ &quadMesh, &quadMeshData, &quadTransform[i], true, true });
+
+	//Objects sharing a mesh and lit variant become one instanced draw, in the lit and shadow passes
+	InstanceBatches instanceBatches;
+	bool instancedDraws = true;
+	std::vector<glm::mat4> objectModels(sceneObjects.size());
+	std::vector<glm::mat3> objectNormalMatrices(sceneObjects.size());
+	{
+		std::vector<ew::Mesh*> meshes;
+		std::vector<int> groups;
+		for (const SceneObject& object : sceneObjects) {
+			meshes.push_back(object.mesh);
+			groups.push_back(object.useTexture2 ? 1 : 0);
+		}
+		instanceBatches.build(meshes, groups);
+	}
 
 	//Enable back face culling
 	glEnable(GL_CULL_FACE);
@@ -324,6 +417,19 @@ int main() {
 	pointLights[0].intensity = 1.0;
 	pointLights[0].isOn = 1;
 
+	//Remaining point lights start off, spread around the room
+	for (int i = 1; i < MAX_LIGHTS; i++) {
+		float angle = glm::radians(360.0f / (MAX_LIGHTS - 1) * i);
+		lightTransformPoint[i].scale = glm::vec3(0.5f);
+		pointLights[i].radius = 15.0;
+		pointLights[i].position = glm::vec3(cos(angle) * 5.0f, 4.0f, sin(angle) * 5.0f);
+		pointLights[i].color = glm::vec3(1.0, 1.0, 1.0);
+		pointLights[i].intensity = 1.0;
+		pointLights[i].isOn = 0;
+		pointLights[i].shadowProjection = SHADOW_PROJECTION_CUBE;
+	}
+	int selectedLight = 0;
+
 	//Directional Light Set Up
 	dirLight[0].color = glm::vec3(1);
 	dirLight[0].intensity = 1.0;
@@ -343,13 +449,92 @@ int main() {
 	spotLight[0].maxAngle = 45.0;
 	spotLight[0].isOn = 0;
 
+	//Bound to LIGHT_BLOCK_BINDING once, shaders/lights.glsl declares the block with the same binding
+	LightBuffer lightBuffer;
+	lightBuffer.update(pointLights, dirLight, spotLight);
+
+	//The starting lights' variants are compiled up front, others the first frame they are needed
+	bool pointLightShadows = true;
+	bool prevPointLightShadows = pointLightShadows;
+	unsigned int startFeatures = litLightFeatures(lightBuffer.getLightCounts(), pointLightShadows) | (instancedDraws ? LIT_INSTANCED : 0);
+	litShader.prewarm({ startFeatures | LIT_NORMAL_MAP, startFeatures | LIT_FLOOR_TEXTURE });
+
+	//Many small unshadowed lights, drifting around inside the room, lit through the clusters
+	const int MAX_CLUSTER_LIGHTS = 4096;
+	LightClusters lightClusters(0.1f, 100.0f);
+	bool useClusteredLights = false;
+	int numClusterLights = 1024;
+	float clusterLightRadius = 1.0f;
+	std::vector<ClusterLight> clusterLights;
+	std::vector<glm::vec3> clusterLightOrigins(MAX_CLUSTER_LIGHTS);
+	std::vector<glm::vec3> clusterLightColors(MAX_CLUSTER_LIGHTS);
+	int renderPath = RENDER_PATH_FORWARD;
+	GBuffer gBuffer;
+	ew::GpuTimer gBufferTimer;
+	ew::GpuTimer deferredLightingTimer;
+	srand(1);
+	auto randomFloat = [](float min, float max) { return min + (max - min) * rand() / (float)RAND_MAX; };
+	for (int i = 0; i < MAX_CLUSTER_LIGHTS; i++) {
+		clusterLightOrigins[i] = glm::vec3(randomFloat(-6.5f, 6.5f), randomFloat(-6.5f, 6.5f), randomFloat(-6.5f, 6.5f));
+		clusterLightColors[i] = glm::vec3(randomFloat(0.2f, 1.0f), randomFloat(0.2f, 1.0f), randomFloat(0.2f, 1.0f));
+	}
+
 	//Shadow Data setup
 	float minBias = 0.005;
 	float maxBias = 0.015;
+	ShadowCache shadowCache;
+	bool cacheShadows = true;
+	ShadowScheduler shadowScheduler;
+	bool timeSliceShadows = true;
+	int shadowFaceBudget = 12;
+	bool cullShadowFaces = true;
+	std::vector<ShadowCaster> shadowCasters(sceneObjects.size());
+	std::vector<int> casterFaceMasks;
+	std::vector<int> staticCasterFaceMasks;
+	std::vector<int> dynamicCasterFaceMasks;
+	bool splitStaticShadows = true;
+	bool prevSplitStatic = false;
+	bool useVertexLayer = vertexLayerSupported;
+	bool benchmarkLayerPaths = false;
+	int shadowFilter = SHADOW_FILTER_PCF;
+	int prevShadowFilter = shadowFilter;
+	float lightBleedReduction = 0.2f;
+	int shadowQuality = 2;
+	bool adaptiveShadows = true;
+	bool useShadowAtlas = false;
+	bool prevAtlasShadows = false;
+	bool benchmarkProjections = false;
+	int prevLightProjections[MAX_LIGHTS] = {};
+	//Planes the shadow maps were last drawn with, faces drawn with others decode to the wrong depths
+	float prevNearPlanes[MAX_LIGHTS] = {};
+	float prevFarPlanes[MAX_LIGHTS] = {};
+	int frameCount = 0;
+
+	//Index 0 times the geometry shader path, 1 the vertex layer path
+	ew::GpuTimer shadowPassTimers[2];
+	ew::GpuTimer litPassTimer;
+	//Depth prepass before the forward lit pass, which then only shades the closest fragment of each pixel
+	bool forwardDepthPrepass = false;
+	ew::GpuTimer depthPrepassTimer;
+	ew::SampleCounter litFragmentCounter;
+	//Shadow pass time with every light on the cube, tetrahedron or dual paraboloid projection
+	ew::GpuTimer projectionTimers[3];
+	const char* projectionNames[3] = { "Cube", "Tetrahedron", "Dual Paraboloid" };
+	bool useShadowMask = false;
+	bool halfResShadowMask = true;
+	ew::GpuTimer shadowMaskTimer;
+	bool softwareShadowLight = false;
+	int prevSoftwareLight = -1;
+	bool validateSoftwareShadows = false;
+	bool benchmarkSoftwareShadows = false;
+	bool softwareValidated = false;
+	float softwareMaxError = 0.0f;
+	float softwareMismatchPercent = 0.0f;
+	double softwareBenchmarkRate = 0.0;
+	std::vector<SoftwareShadowCaster> softwareCasters;
+	std::vector<float> gpuShadowFace(SHADOW_WIDTH * SHADOW_HEIGHT);
 
 	while (!glfwWindowShouldClose(window)) {
-		litShader.use();
-
 		processInput(window);
 		glClearColor(bgColor.r,bgColor.g,bgColor.b, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -369,17 +554,21 @@ int main() {
 		glBindTexture(GL_TEXTURE_2D, floorTexture);
 		
 		litShader.setInt("_FloorTexture", 0);
+		gBufferShader.setInt("_FloorTexture", 0);
 
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, objectTexture);
 
 		litShader.setInt("_ObjectTexture", 1);
+		gBufferShader.setInt("_ObjectTexture", 1);
 
 		glActiveTexture(GL_TEXTURE2);
 		glBindTexture(GL_TEXTURE_2D, objectNormalTexture);
 
 		litShader.setInt("_ObjectNormalMap", 2);
 		litShader.setFloat("_NormalIntensity", normalIntensity);
+		gBufferShader.setInt("_ObjectNormalMap", 2);
+		gBufferShader.setFloat("_NormalIntensity", normalIntensity);
 
 		//Update PointLight Positions
 		for (int i = 0; i < MAX_LIGHTS; i++) {
@@ -415,110 +604,626 @@ int main() {
 		litShader.setFloat("_Material.diffuseK", material.diffuseK);
 		litShader.setFloat("_Material.specularK", material.specularK);
 		litShader.setFloat("_Material.shininess", material.shininess);
+		gBufferShader.setFloat("_Material.ambientK", material.ambientK);
+		gBufferShader.setFloat("_Material.diffuseK", material.diffuseK);
+		gBufferShader.setFloat("_Material.specularK", material.specularK);
+		gBufferShader.setFloat("_Material.shininess", material.shininess);
+
+		//Every program reads the lights from one uniform buffer, uploaded only on the frames they change
+		lightBuffer.update(pointLights, dirLight, spotLight);
+
+		//Draw from Camera POV
+		litShader.setVec3("camPos", camera.getPosition());
 
-		//Set Point Light Uniforms
+		litShader.setMat4("_Projection", camera.getProjectionMatrix());
+		litShader.setMat4("_View", camera.getViewMatrix());
+		gBufferShader.setMat4("_Projection", camera.getProjectionMatrix());
+		gBufferShader.setMat4("_View", camera.getViewMatrix());
+		bool deferred = renderPath == RENDER_PATH_TILED_DEFERRED;
+
+		//Clustered lights are assigned against this frame's camera. The deferred path culls them per tile on the GPU instead
+		if (useClusteredLights) {
+			clusterLights.resize(numClusterLights);
+			for (int i = 0; i < numClusterLights; i++) {
+				float phase = time + i * 0.37f;
+				clusterLights[i].position = clusterLightOrigins[i] + glm::vec3(sinf(phase), cosf(phase * 0.7f), sinf(phase * 1.3f)) * 0.5f;
+				clusterLights[i].radius = clusterLightRadius;
+				clusterLights[i].color = clusterLightColors[i];
+				clusterLights[i].intensity = 0.5f;
+			}
+			if (deferred)
+				lightClusters.uploadLights(clusterLights);
+			else
+				lightClusters.update(clusterLights, camera.getViewMatrix(), camera.getFov(), (float)SCREEN_WIDTH / SCREEN_HEIGHT);
+			litShader.setVec2("_ClusterTileSize", glm::vec2((float)SCREEN_WIDTH / LightClusters::CLUSTERS_X, (float)SCREEN_HEIGHT / LightClusters::CLUSTERS_Y));
+			litShader.setFloat("_ClusterDepthScale", lightClusters.getDepthScale());
+			litShader.setFloat("_ClusterDepthBias", lightClusters.getDepthBias());
+			litShader.setVec3("_CameraForward", glm::normalize(camera.getForward()));
+		}
+
+		if (instancedDraws) {
+			for (size_t i = 0; i < sceneObjects.size(); i++) {
+				objectModels[i] = sceneObjects[i].transform->getModelMatrix();
+				objectNormalMatrices[i] = sceneObjects[i].transform->getNormalMatrix();
+			}
+			instanceBatches.updateTransforms(objectModels, objectNormalMatrices);
+		}
+
+		//Point light shadows render
+		//Only faces whose light or casters changed since last frame get re-rendered
+		for (size_t i = 0; i < sceneObjects.size(); i++) {
+			shadowCasters[i].bounds = ew::transformAABB(sceneObjects[i].mesh->getBounds(), sceneObjects[i].transform->getModelMatrix());
+			shadowCasters[i].moved = sceneObjects[i].transform->isDirty();
+			shadowCasters[i].isStatic = sceneObjects[i].isStatic;
+		}
+		//Benchmark mode alternates the layer paths every frame and re-renders everything so both do the same work
+		//The atlas only stores distances and is always drawn with the geometry shader
+		bool atlasShadows = useShadowAtlas && shadowFilter == SHADOW_FILTER_PCF;
+		bool vertexLayer = vertexLayerSupported && useVertexLayer && !atlasShadows;
+		if (benchmarkLayerPaths)
+			vertexLayer = vertexLayerSupported && frameCount % 2 == 1 && !atlasShadows;
+		bool momentShadows = shadowFilter >= SHADOW_FILTER_VSM;
+		int shadowKind = shadowFilter == SHADOW_FILTER_PCF ? 0 : shadowFilter == SHADOW_FILTER_HARDWARE_PCF ? 1 : 2;
+		Shader& atlasShader = instancedDraws ? instancedAtlasDepthShader : atlasDepthShader;
+		Shader& shadowShader = atlasShadows ? atlasShader : *shadowShaders[instancedDraws ? 1 : 0][vertexLayer ? 1 : 0][shadowKind];
+		if (momentShadows)
+			momentShadowMap.setFilter((ShadowFilter)shadowFilter);
+		bool atlasResized = shadowAtlas.setBudget(shadowAtlasBudgetMB);
+
+		//Tetrahedron and paraboloid faces only store distances in the cube array.
+		//Benchmark mode cycles every light through the three projections
+		bool projectionsAllowed = shadowFilter == SHADOW_FILTER_PCF && !atlasShadows;
+		bool projectionBenchmark = benchmarkProjections && projectionsAllowed;
+		int lightProjections[MAX_LIGHTS];
+		bool anyParaboloid = false;
 		for (int i = 0; i < MAX_LIGHTS; i++) {
-			litShader.setFloat("_PointLights[" + std::to_string(i) + "].radius", pointLights[i].radius);
-			litShader.setVec3("_PointLights[" + std::to_string(i) + "].position", pointLights[i].position); //need +std::to_string(0)+ for for loop
-			litShader.setFloat("_PointLights[" + std::to_string(i) + "].intensity", pointLights[i].intensity);
-			litShader.setVec3("_PointLights[" + std::to_string(i) + "].color", pointLights[i].color);
-			litShader.setInt("_PointLights[" + std::to_string(i) + "].isOn", pointLights[i].isOn);
+			lightProjections[i] = projectionBenchmark ? frameCount % 3 : pointLights[i].shadowProjection;
+			if (!projectionsAllowed)
+				lightProjections[i] = SHADOW_PROJECTION_CUBE;
+			anyParaboloid |= lightProjections[i] == SHADOW_PROJECTION_DUAL_PARABOLOID;
 		}
 
-		//Set Directiona Light Uniforms
+		//Static casters get their own cached cube, only the cube array storage has one
+		bool splitStatic = splitStaticShadows && !momentShadows && !atlasShadows;
+
+		//The software rasterizer writes plain cube faces of distances
+		int softwareLight = softwareShadowLight && projectionsAllowed && lightProjections[selectedLight] == SHADOW_PROJECTION_CUBE ? selectedLight : -1;
+
+		//Switching shadow filters or storage changes what the cube faces store
+		bool shadowsInvalidated = !cacheShadows || benchmarkLayerPaths || projectionBenchmark || shadowFilter != prevShadowFilter || atlasShadows != prevAtlasShadows
+			|| atlasResized || splitStatic != prevSplitStatic || softwareLight != prevSoftwareLight || pointLightShadows != prevPointLightShadows;
+		if (shadowsInvalidated)
+			shadowCache.invalidateAll();
+		prevShadowFilter = shadowFilter;
+		prevAtlasShadows = atlasShadows;
+		prevSplitStatic = splitStatic;
+		prevSoftwareLight = softwareLight;
+		prevPointLightShadows = pointLightShadows;
+
+		//Far plane where the light's attenuation reaches zero, near plane just in front of the closest caster
+		float nearPlanes[MAX_LIGHTS];
+		float farPlanes[MAX_LIGHTS];
 		for (int i = 0; i < MAX_LIGHTS; i++) {
-			litShader.setVec3("_DirLight[" + std::to_string(i) + "].direction", dirLight[i].direction);
-			litShader.setFloat("_DirLight[" + std::to_string(i) + "].intensity", dirLight[i].intensity);
-			litShader.setVec3("_DirLight[" + std::to_string(i) + "].color", dirLight[i].color);
-			litShader.setInt("_DirLight[" + std::to_string(i) + "].isOn", dirLight[i].isOn);
+			farPlanes[i] = glm::max(pointLights[i].radius, MIN_SHADOW_FAR_PLANE);
+			float nearest = nearestCasterDistance(shadowCasters, pointLights[i].position, farPlanes[i]);
+			nearPlanes[i] = fitShadowNearPlane(nearest * PointShadowMap::getNearPlaneScale((ShadowProjection)lightProjections[i]), farPlanes[i]);
 		}
-		
-		//Set Spot Light Uniforms
+		int faceMasks[MAX_LIGHTS];
+		int staticFaceMasks[MAX_LIGHTS];
+		shadowCache.update(pointLights, nearPlanes, farPlanes, shadowCasters, faceMasks, staticFaceMasks);
+
+		//The cache works in cube faces, other projections redraw all their faces when anything changed
+		bool mustRenderShadows[MAX_LIGHTS];
 		for (int i = 0; i < MAX_LIGHTS; i++) {
-			litShader.setFloat("_SpotLight[" + std::to_string(i) + "].radius", spotLight[i].radius);
-			litShader.setVec3("_SpotLight[" + std::to_string(i) + "].direction", spotLight[i].direction);
-			litShader.setFloat("_SpotLight[" + std::to_string(i) + "].intensity", spotLight[i].intensity);
-			litShader.setVec3("_SpotLight[" + std::to_string(i) + "].color", spotLight[i].color);
-			litShader.setVec3("_SpotLight[" + std::to_string(i) + "].position", spotLight[i].position);
-			litShader.setFloat("_SpotLight[" + std::to_string(i) + "].minAngle", spotLight[i].minAngle);
-			litShader.setFloat("_SpotLight[" + std::to_string(i) + "].maxAngle", spotLight[i].maxAngle);
-			litShader.setInt("_SpotLight[" + std::to_string(i) + "].isOn", spotLight[i].isOn);
+			ShadowProjection projection = (ShadowProjection)lightProjections[i];
+			//Nothing in the maps is usable after a switch, time-slicing or not. The lit shaders decode every face with
+			//this frame's near and far planes, so a refit can't leave some faces drawn with the old ones either
+			bool planesChanged = nearPlanes[i] != prevNearPlanes[i] || farPlanes[i] != prevFarPlanes[i];
+			mustRenderShadows[i] = shadowsInvalidated || !timeSliceShadows || projection != prevLightProjections[i] || planesChanged;
+			prevNearPlanes[i] = nearPlanes[i];
+			prevFarPlanes[i] = farPlanes[i];
+			if (projection != prevLightProjections[i]) {
+				faceMasks[i] = ALL_CUBE_FACES;
+				staticFaceMasks[i] = ALL_CUBE_FACES;
+			}
+			if (projection != SHADOW_PROJECTION_CUBE && faceMasks[i] != 0)
+				faceMasks[i] = PointShadowMap::getProjectionFaceMask(projection);
+			if (projection != SHADOW_PROJECTION_CUBE && staticFaceMasks[i] != 0)
+				staticFaceMasks[i] = PointShadowMap::getProjectionFaceMask(projection);
+			prevLightProjections[i] = projection;
 		}
 
-		//Draw from Camera POV
-		litShader.use();
-		litShader.setVec3("camPos", camera.getPosition());
+		//Out of date faces past this frame's budget wait for a later frame, less important lights wait longest
+		shadowScheduler.schedule(pointLights, camera.getPosition(), mustRenderShadows, shadowFaceBudget, faceMasks, staticFaceMasks);
+
+		//Casters within the light's far plane, as the software rasterizer takes them
+		auto gatherSoftwareCasters = [&](int light) {
+			softwareCasters.clear();
+			for (size_t i = 0; i < sceneObjects.size(); i++) {
+				if (distanceToBounds(shadowCasters[i].bounds, pointLights[light].position) <= farPlanes[light])
+					softwareCasters.push_back({ sceneObjects[i].meshData, sceneObjects[i].transform->getModelMatrix() });
+			}
+		};
+
+		//The software light's out of date faces are rendered on the CPU and uploaded, the GPU pass skips that light
+		if (softwareLight >= 0) {
+			if (faceMasks[softwareLight] != 0) {
+				gatherSoftwareCasters(softwareLight);
+				softwareShadows.render(softwareCasters, pointLights[softwareLight].position, nearPlanes[softwareLight], farPlanes[softwareLight],
+					faceMasks[softwareLight]);
+				for (int face = 0; face < 6; face++) {
+					if (faceMasks[softwareLight] & (1 << face))
+						pointShadowMap.uploadFace(softwareLight, face, softwareShadows.getFace(face));
+				}
+			}
+			faceMasks[softwareLight] = 0;
+			staticFaceMasks[softwareLight] = 0;
+		}
 
-		litShader.setMat4("_Projection", camera.getProjectionMatrix());
-		litShader.setMat4("_View", camera.getViewMatrix());
+		//With shadows off the lit variants don't read the maps, so nothing is rendered into them
+		if (!pointLightShadows) {
+			for (int i = 0; i < MAX_LIGHTS; i++) {
+				faceMasks[i] = 0;
+				staticFaceMasks[i] = 0;
+			}
+		}
 
-		litShader.setFloat("_MinBias", minBias);
-		litShader.setFloat("_MaxBias", maxBias);
+		//Faces whose resolution or place in the atlas changed have to be re-rendered too
+		glm::vec4 atlasRects[MAX_LIGHTS * 6];
+		if (atlasShadows) {
+			glm::mat4 viewProj = camera.getProjectionMatrix() * camera.getViewMatrix();
+			float pixelsPerRadian = SCREEN_HEIGHT / (2.0f * tanf(glm::radians(camera.getFov()) * 0.5f));
+			shadowAtlas.pack(pointLights, viewProj, camera.getPosition(), pixelsPerRadian, faceMasks);
+			for (int i = 0; i < MAX_LIGHTS * 6; i++)
+				atlasRects[i] = shadowAtlas.getRectUV(i / 6, i % 6);
+			atlasShader.setVec4Array("_AtlasRects", atlasRects, MAX_LIGHTS * 6);
+		}
 
-		//Point light shadows render
-		float aspect = (float)SHADOW_WIDTH / (float)SHADOW_HEIGHT;
-		float near = 1.0f;
-		float far = 25.0f;
-		glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), aspect, near, far);
-
-		std::vector<glm::mat4> shadowTransforms;
-		shadowTransforms.push_back(shadowProj *
-			glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-		shadowTransforms.push_back(shadowProj *
-			glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(-1.0, 0.0, 0.0), glm::vec3(0.0, -1.0, 0.0)));
-		shadowTransforms.push_back(shadowProj *
-			glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0, 1.0, 0.0), glm::vec3(0.0, 0.0, 1.0)));
-		shadowTransforms.push_back(shadowProj *
-			glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0, -1.0, 0.0), glm::vec3(0.0, 0.0, -1.0)));
-		shadowTransforms.push_back(shadowProj *
-			glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0, 0.0, 1.0), glm::vec3(0.0, -1.0, 0.0)));
-		shadowTransforms.push_back(shadowProj *
-			glm::lookAt(pointLights[0].position, pointLights[0].position + glm::vec3(0.0, 0.0, -1.0), glm::vec3(0.0, -1.0, 0.0)));
+		//Every light's cube faces are written by one layered draw, faces not in the mask are skipped
+		bool anyShadows = false;
+		//Tetrahedron lights only fill 4 of their 6 matrices, the rest still get uploaded.
+		//glm's default constructor leaves them uninitialized, so = {} wouldn't be enough
+		glm::mat4 shadowMatrices[MAX_LIGHTS * 6];
+		std::fill(shadowMatrices, shadowMatrices + MAX_LIGHTS * 6, glm::mat4(1.0f));
+		glm::vec3 lightPositions[MAX_LIGHTS];
+		for (int i = 0; i < MAX_LIGHTS; i++) {
+			//Paraboloid faces are projected in the shader, their matrices go unused
+			if (lightProjections[i] == SHADOW_PROJECTION_TETRAHEDRON)
+				PointShadowMap::getTetrahedronMatrices(pointLights[i].position, nearPlanes[i], farPlanes[i], &shadowMatrices[i * 6]);
+			else
+				PointShadowMap::getFaceMatrices(pointLights[i].position, nearPlanes[i], farPlanes[i], &shadowMatrices[i * 6]);
+			lightPositions[i] = pointLights[i].position;
+			anyShadows |= faceMasks[i] != 0;
+		}
+		shadowShader.getUniform<glm::mat4>("_ShadowMatrices").setArray(shadowMatrices, MAX_LIGHTS * 6);
+		shadowShader.getUniform<glm::vec3>("lightPos").setArray(lightPositions, MAX_LIGHTS);
+		shadowShader.getUniform<float>("far_plane").setArray(farPlanes, MAX_LIGHTS);
+		shadowShader.setInt("_ShadowFilter", shadowFilter);
+		shadowShader.setIntArray("_ShadowProjection", lightProjections, MAX_LIGHTS);
+
+		//Each caster is only sent to the faces its bounds overlap.
+		//Non-cube lights are culled against the whole light, a caster touching any cube face gets all their faces
+		int cullFaceMasks[MAX_LIGHTS];
+		for (int i = 0; i < MAX_LIGHTS; i++)
+			cullFaceMasks[i] = lightProjections[i] == SHADOW_PROJECTION_CUBE || faceMasks[i] == 0 ? faceMasks[i] : ALL_CUBE_FACES;
+		buildCasterFaceMasks(shadowCasters, pointLights, cullFaceMasks, farPlanes, cullShadowFaces, casterFaceMasks);
+		for (size_t i = 0; i < sceneObjects.size(); i++) {
+			for (int light = 0; light < MAX_LIGHTS; light++) {
+				int& casterMask = casterFaceMasks[i * MAX_LIGHTS + light];
+				if (lightProjections[light] != SHADOW_PROJECTION_CUBE && casterMask != 0)
+					casterMask = faceMasks[light];
+			}
+		}
+
+		//Static casters are only drawn into the static cube when it is out of date, dynamic ones into the working cube
+		bool anyStaticFaces = false;
+		staticCasterFaceMasks.assign(casterFaceMasks.size(), 0);
+		dynamicCasterFaceMasks.assign(casterFaceMasks.size(), 0);
+		for (size_t i = 0; i < sceneObjects.size(); i++) {
+			for (int light = 0; light < MAX_LIGHTS; light++) {
+				int casterMask = casterFaceMasks[i * MAX_LIGHTS + light];
+				if (sceneObjects[i].isStatic)
+					staticCasterFaceMasks[i * MAX_LIGHTS + light] = casterMask & staticFaceMasks[light];
+				else
+					dynamicCasterFaceMasks[i * MAX_LIGHTS + light] = casterMask;
+			}
+		}
+		for (int i = 0; i < MAX_LIGHTS; i++)
+			anyStaticFaces |= staticFaceMasks[i] != 0;
+
+		int shadowTriangles = 0;
+		int culledShadowTriangles = 0;
+		int reusedStaticTriangles = 0;
+		for (size_t i = 0; i < sceneObjects.size(); i++) {
+			int triangles = sceneObjects[i].mesh->getNumIndices() / 3;
+			for (int light = 0; light < MAX_LIGHTS; light++) {
+				int wantedFaces = countCubeFaces(casterFaceMasks[i * MAX_LIGHTS + light]);
+				int drawnFaces = wantedFaces;
+				if (splitStatic && sceneObjects[i].isStatic)
+					drawnFaces = countCubeFaces(staticCasterFaceMasks[i * MAX_LIGHTS + light]);
+				shadowTriangles += triangles * drawnFaces;
+				culledShadowTriangles += triangles * (countCubeFaces(faceMasks[light]) - wantedFaces);
+				reusedStaticTriangles += triangles * (wantedFaces - drawnFaces);
+			}
+		}
 
 		//Dpeth Render
-		glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-		glCullFace(GL_FRONT);
-		depthShader.use();
-		depthShader.setVec3("lightPos", pointLights[0].position);
-		depthShader.setFloat("far_plane", far);
-		for (int i = 0; i < 6; i++) {
-			depthShader.setMat4("_ShadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-		}
-		drawScene(depthShader);
+		ew::GpuTimer& shadowPassTimer = projectionBenchmark ? projectionTimers[frameCount % 3] : shadowPassTimers[vertexLayer ? 1 : 0];
+		shadowPassTimer.begin();
+		if (anyShadows) {
+			glCullFace(GL_FRONT);
+			shadowShader.use();
+			if (atlasShadows) {
+				for (int plane = 0; plane < 4; plane++)
+					glEnable(GL_CLIP_DISTANCE0 + plane);
+			}
+			if (anyParaboloid)
+				glEnable(GL_CLIP_DISTANCE0);
+
+			if (splitStatic && anyStaticFaces) {
+				pointShadowMap.bindStaticForWriting();
+				for (int i = 0; i < MAX_LIGHTS; i++) {
+					for (int face = 0; face < 6; face++) {
+						if (staticFaceMasks[i] & (1 << face))
+							pointShadowMap.clearStaticFace(i, face);
+					}
+				}
+				drawShadowCasters(shadowShader, staticCasterFaceMasks, vertexLayer, instancedDraws ? &instanceBatches : nullptr);
+			}
+
+			if (momentShadows)
+				momentShadowMap.bindForWriting();
+			else if (atlasShadows)
+				shadowAtlas.bindForWriting();
+			else
+				pointShadowMap.bindForWriting();
+			for (int i = 0; i < MAX_LIGHTS; i++) {
+				for (int face = 0; face < 6; face++) {
+					if ((faceMasks[i] & (1 << face)) == 0)
+						continue;
+					if (momentShadows)
+						momentShadowMap.clearFace(i, face);
+					else if (atlasShadows)
+						shadowAtlas.clearFace(i, face);
+					else if (splitStatic)
+						pointShadowMap.restoreStaticFace(i, face);
+					else
+						pointShadowMap.clearFace(i, face);
+				}
+			}
+			drawShadowCasters(shadowShader, splitStatic ? dynamicCasterFaceMasks : casterFaceMasks, vertexLayer, instancedDraws ? &instanceBatches : nullptr);
+			if (atlasShadows) {
+				for (int plane = 0; plane < 4; plane++)
+					glDisable(GL_CLIP_DISTANCE0 + plane);
+			}
+			if (anyParaboloid)
+				glDisable(GL_CLIP_DISTANCE0);
+			if (momentShadows)
+				momentShadowMap.blurFaces(faceMasks, momentBlurShader, fullscreenQuadMesh);
+		}
+		shadowPassTimer.end();
+
+		//Renders the selected light on the CPU and compares every face with what is in the cube array now.
+		//Coverage differences on silhouettes and small depth differences are expected, the two rasterize slightly differently
+		if (validateSoftwareShadows || benchmarkSoftwareShadows) {
+			gatherSoftwareCasters(selectedLight);
+			const int BENCHMARK_RUNS = 10;
+			double totalRate = 0.0;
+			for (int run = 0; run < (benchmarkSoftwareShadows ? BENCHMARK_RUNS : 1); run++) {
+				softwareShadows.render(softwareCasters, pointLights[selectedLight].position, nearPlanes[selectedLight], farPlanes[selectedLight], ALL_CUBE_FACES);
+				totalRate += softwareShadows.getTrianglesPerSecondPerThread();
+			}
+			if (benchmarkSoftwareShadows)
+				softwareBenchmarkRate = totalRate / BENCHMARK_RUNS;
+			else {
+				const float MISMATCH_THRESHOLD = 0.01f;
+				int mismatches = 0;
+				softwareMaxError = 0.0f;
+				for (int face = 0; face < 6; face++) {
+					pointShadowMap.readFace(selectedLight, face, gpuShadowFace.data());
+					const float* cpuFace = softwareShadows.getFace(face);
+					for (int i = 0; i < SHADOW_WIDTH * SHADOW_HEIGHT; i++) {
+						float error = fabsf(cpuFace[i] - gpuShadowFace[i]);
+						if (error > MISMATCH_THRESHOLD)
+							mismatches++;
+						else
+							softwareMaxError = glm::max(softwareMaxError, error);
+					}
+				}
+				softwareMismatchPercent = 100.0f * mismatches / (6.0f * SHADOW_WIDTH * SHADOW_HEIGHT);
+				softwareValidated = true;
+			}
+			validateSoftwareShadows = false;
+			benchmarkSoftwareShadows = false;
+		}
+
+		//Shadow maps and settings read by pointShadows.glsl, in the lit shader and the shadow mask shader
+		pointShadowMap.bindTexture(GL_TEXTURE4);
+		pointShadowMap.bindCompareTexture(GL_TEXTURE5);
+		momentShadowMap.bindTexture(GL_TEXTURE6);
+		shadowAtlas.bindTexture(GL_TEXTURE7);
+		pointShadowMap.bindLayerTexture(GL_TEXTURE8);
+		glm::mat4 tetrahedronMatrices[4];
+		PointShadowMap::getTetrahedronMatrices(glm::vec3(0.0f), MIN_SHADOW_NEAR_PLANE, MIN_SHADOW_FAR_PLANE, tetrahedronMatrices);
+		auto setPointShadowUniforms = [&](auto& shader) {
+			shader.setInt("_PointShadowMap", 4);
+			shader.setInt("_PointShadowCompareMap", 5);
+			shader.setInt("_PointMomentMap", 6);
+			shader.setInt("_ShadowAtlas", 7);
+			shader.setInt("_UseShadowAtlas", atlasShadows);
+			shader.setInt("_PointShadowLayers", 8);
+			shader.setIntArray("_ShadowProjection", lightProjections, MAX_LIGHTS);
+			shader.setMat4Array("_TetrahedronMatrices", tetrahedronMatrices, 4);
+			shader.setInt("_ShadowFilter", shadowFilter);
+			shader.setFloat("_LightBleedReduction", lightBleedReduction);
+			shader.setInt("_ShadowQuality", shadowQuality);
+			shader.setInt("_AdaptiveShadows", adaptiveShadows);
+			shader.setFloat("_MinBias", minBias);
+			shader.setFloat("_MaxBias", maxBias);
+			shader.setFloatArray("_ShadowNearPlanes", nearPlanes, MAX_LIGHTS);
+			shader.setFloatArray("_ShadowFarPlanes", farPlanes, MAX_LIGHTS);
+			//Every path that samples the atlas reads its faces through these
+			if (atlasShadows)
+				shader.setVec4Array("_AtlasRects", atlasRects, MAX_LIGHTS * 6);
+		};
+
+		//Screen-space shadow mask: depth prepass, then each light's shadow resolved once per visible pixel.
+		//The deferred path already resolves shadows once per pixel
+		if (useShadowMask && pointLightShadows && !deferred) {
+			shadowMaskTimer.begin();
+			//Distances and per light shadows are data, blending would scale them by whatever ends up in alpha
+			glDisable(GL_BLEND);
+			shadowMask.resize(SCREEN_WIDTH, SCREEN_HEIGHT, halfResShadowMask);
+			shadowMask.bindPrepassForWriting();
+			glCullFace(GL_BACK);
+			depthPrepassShader.use();
+			depthPrepassShader.setMat4("_Projection", camera.getProjectionMatrix());
+			depthPrepassShader.setMat4("_View", camera.getViewMatrix());
+			depthPrepassShader.setVec3("camPos", camera.getPosition());
+			drawSceneDepth(depthPrepassShader);
+
+			shadowMask.bindMaskForWriting();
+			shadowMask.bindDistanceTexture(GL_TEXTURE9);
+			shadowMaskShader.use();
+			setPointShadowUniforms(shadowMaskShader);
+			shadowMaskShader.setVec3("camPos", camera.getPosition());
+			shadowMaskShader.setMat4("_InverseViewProjection", glm::inverse(camera.getProjectionMatrix() * camera.getViewMatrix()));
+			shadowMaskShader.setInt("_SceneDistance", 9);
+			shadowMaskShader.setInt("_MaskScale", shadowMask.getScale());
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+			fullscreenQuadMesh.draw();
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_CULL_FACE);
+			glEnable(GL_BLEND);
+			shadowMaskTimer.end();
+		}
 
+		//Deferred Render
+		if (deferred) {
+			glCullFace(GL_BACK);
+			gBufferTimer.begin();
+			gBuffer.resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+			gBuffer.bindForWriting();
+			drawScene(gBufferShader, 0, normalIntensity > 0.0f, instancedDraws ? &instanceBatches : nullptr);
+			gBufferTimer.end();
+
+			deferredLightingTimer.begin();
+			gBuffer.bindTextures(GL_TEXTURE11);
+			tileCullingShader.use();
+			tileCullingShader.setInt("_GBufferDepth", 14);
+			tileCullingShader.setMat4("_View", camera.getViewMatrix());
+			tileCullingShader.setMat4("_InverseProjection", glm::inverse(camera.getProjectionMatrix()));
+			tileCullingShader.setInt("_NumClusterLights", useClusteredLights ? numClusterLights : 0);
+			glDispatchCompute(gBuffer.getNumTilesX(), gBuffer.getNumTilesY(), 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			deferredLitShader.use();
+			setPointShadowUniforms(deferredLitShader);
+			deferredLitShader.setVec3("camPos", camera.getPosition());
+			deferredLitShader.setMat4("_InverseViewProjection", glm::inverse(camera.getProjectionMatrix() * camera.getViewMatrix()));
+			deferredLitShader.setInt("_UsePointShadows", pointLightShadows);
+			deferredLitShader.setInt("_GBufferNormal", 11);
+			deferredLitShader.setInt("_GBufferAlbedo", 12);
+			deferredLitShader.setInt("_GBufferMaterial", 13);
+			deferredLitShader.setInt("_GBufferDepth", 14);
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_CULL_FACE);
+			fullscreenQuadMesh.draw();
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_CULL_FACE);
+			//Off since bindForWriting, only the forward light spheres below blend
+			glEnable(GL_BLEND);
+			deferredLightingTimer.end();
+
+			//The light spheres below are still drawn forward, against the scene's depth
+			gBuffer.blitDepthToScreen();
+		}
 		//Normal Render
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		litShader.use();
-		glCullFace(GL_BACK);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
-		litShader.setInt("_PointShadowMap", 4);
-		litShader.setFloat("_FarPlane", far);
-		litShader.setInt("_UseTexture2", false);
-		drawScene(litShader);
-
-		//Draw light as a small sphere using unlit shader, ironically.
+		else {
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glCullFace(GL_BACK);
+			setPointShadowUniforms(litShader);
+			litShader.setInt("_UseShadowMask", useShadowMask);
+			if (useShadowMask && pointLightShadows) {
+				shadowMask.bindMaskTexture(GL_TEXTURE10);
+				litShader.setInt("_ShadowMask", 10);
+				litShader.setInt("_SceneDistance", 9);
+				litShader.setInt("_MaskScale", shadowMask.getScale());
+			}
+			if (forwardDepthPrepass) {
+				depthPrepassTimer.begin();
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				screenDepthShader.use();
+				screenDepthShader.setMat4("_Projection", camera.getProjectionMatrix());
+				screenDepthShader.setMat4("_View", camera.getViewMatrix());
+				drawSceneDepth(screenDepthShader);
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+				depthPrepassTimer.end();
+				//Depth is final, only the fragment that won the prepass passes
+				glDepthFunc(GL_EQUAL);
+				glDepthMask(GL_FALSE);
+			}
+			litPassTimer.begin();
+			litFragmentCounter.begin();
+			unsigned int litFeatures = litLightFeatures(lightBuffer.getLightCounts(), pointLightShadows);
+			if (useClusteredLights)
+				litFeatures |= LIT_CLUSTERED_LIGHTS;
+			drawScene(litShader, litFeatures, normalIntensity > 0.0f, instancedDraws ? &instanceBatches : nullptr);
+			litFragmentCounter.end();
+			litPassTimer.end();
+			if (forwardDepthPrepass) {
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+			}
+		}
+
+		//Draw lights as small spheres using unlit shader, ironically.
 		unlitShader.use();
 		unlitShader.setMat4("_Projection", camera.getProjectionMatrix());
 		unlitShader.setMat4("_View", camera.getViewMatrix());
-		unlitShader.setMat4("_Model", lightTransformPoint[0].getModelMatrix());
-		unlitShader.setVec3("_Color", pointLightColors[0]);
-		sphereMesh.draw();
+		for (int i = 0; i < MAX_LIGHTS; i++) {
+			if (pointLights[i].isOn != 1)
+				continue;
+			unlitShader.setMat4("_Model", lightTransformPoint[i].getModelMatrix());
+			unlitShader.setMat3("_NormalMatrix", lightTransformPoint[i].getNormalMatrix());
+			unlitShader.setVec3("_Color", pointLightColors[i]);
+			sphereMesh.draw();
+		}
 		
 		ImGui::Begin("Point Lights");
-		ImGui::ColorEdit3("Light Color", &pointLights[0].color.r);
-		ImGui::DragFloat3("Light Position", &pointLights[0].position.x, 0.1f);
-		ImGui::SliderFloat("Light Intensity", &pointLights[0].intensity, 0.0f, 1.0f);
-		ImGui::SliderFloat("Light Radius", &pointLights[0].radius, 0.0f, 15.0f);
-		ImGui::SliderInt("Light On", &pointLights[0].isOn, 0, 1);
+		ImGui::SliderInt("Selected Light", &selectedLight, 0, MAX_LIGHTS - 1);
+		ImGui::ColorEdit3("Light Color", &pointLights[selectedLight].color.r);
+		ImGui::DragFloat3("Light Position", &pointLights[selectedLight].position.x, 0.1f);
+		ImGui::SliderFloat("Light Intensity", &pointLights[selectedLight].intensity, 0.0f, 1.0f);
+		ImGui::SliderFloat("Light Radius", &pointLights[selectedLight].radius, 0.0f, 15.0f);
+		ImGui::SliderInt("Light On", &pointLights[selectedLight].isOn, 0, 1);
+		ImGui::Combo("Shadow Projection", &pointLights[selectedLight].shadowProjection, "Cube\0" "Tetrahedron\0" "Dual Paraboloid\0");
 		ImGui::SliderFloat("Normal Intensity", &normalIntensity, 0.0f, 1.0f);
+		ImGui::Checkbox("Rotate Shapes", &isRotating);
+		ImGui::Combo("Render Path", &renderPath, "Forward\0" "Tiled Deferred\0");
+		ImGui::Checkbox("Instanced Draws", &instancedDraws);
+		if (instancedDraws)
+			ImGui::Text("Scene draws: %d for %d objects, last shadow pass: %d for %d instances", (int)instanceBatches.getBatches().size(),
+				instanceBatches.getNumObjects(), instanceBatches.getShadowDrawCalls(), instanceBatches.getShadowInstances());
+		else
+			ImGui::Text("Scene draws: %d", (int)sceneObjects.size());
+		if (deferred)
+			ImGui::Text("G-buffer: %.3f ms, tile culling + lighting: %.3f ms", gBufferTimer.getMilliseconds(), deferredLightingTimer.getMilliseconds());
+		else {
+			ImGui::Checkbox("Depth Prepass", &forwardDepthPrepass);
+			if (forwardDepthPrepass)
+				ImGui::Text("Forward lit pass: %.3f ms, prepass: %.3f ms", litPassTimer.getMilliseconds(), depthPrepassTimer.getMilliseconds());
+			else
+				ImGui::Text("Forward lit pass: %.3f ms", litPassTimer.getMilliseconds());
+			//Above 1 per covered pixel is fragments shaded and then overwritten
+			ImGui::Text("Lit fragments shaded: %llu, %.2f per screen pixel", (unsigned long long)litFragmentCounter.getSamples(),
+				(double)litFragmentCounter.getSamples() / (SCREEN_WIDTH * SCREEN_HEIGHT));
+		}
+		ImGui::Checkbox("Clustered Lights", &useClusteredLights);
+		if (useClusteredLights) {
+			ImGui::SliderInt("Clustered Light Count", &numClusterLights, 0, MAX_CLUSTER_LIGHTS);
+			ImGui::SliderFloat("Clustered Light Radius", &clusterLightRadius, 0.1f, 5.0f);
+			if (!deferred) {
+				ImGui::Text("Light assignment: %.2f ms on %d threads", lightClusters.getMilliseconds(), lightClusters.getNumThreads());
+				ImGui::Text("Lights per cluster: %.1f average, %d max, %d indices", lightClusters.getAverageLightsPerCluster(),
+					lightClusters.getMaxLightsPerCluster(), lightClusters.getNumIndices());
+			}
+		}
+		ImGui::Text("Light buffer uploads: %d", lightBuffer.getUploadCount());
+		ImGui::Text("Lit variants: %d, last compile %.1f ms", litShader.getNumVariants(), litShader.getLastCompileMilliseconds());
+		const ew::ProgramBinaryCache::Stats& programCache = ew::ProgramBinaryCache::getStats();
+		ImGui::Text("Program cache: %d hits (%.1f ms), %d misses (%.1f ms), %d rejected", programCache.hits, programCache.hitMilliseconds,
+			programCache.misses, programCache.missMilliseconds, programCache.rejected);
+		//Inactive uniforms that are still being set, and active ones left at their defaults
+		if (ImGui::Button("Print Uniform Report")) {
+			litShader.printReport();
+			gBufferShader.printReport();
+			for (Shader* shader : allShaders)
+				shader->printReport();
+		}
+		ImGui::End();
+
+		ImGui::Begin("Shadows");
 		ImGui::SliderFloat("Min Bias", &minBias, 0.0f, 0.05);
 		ImGui::SliderFloat("Max Bias", &maxBias, 0.0f, 0.05);
-		ImGui::Checkbox("Rotate Shapes", &isRotating);
+		ImGui::Combo("Shadow Filter", &shadowFilter, "PCF\0" "Hardware PCF\0" "VSM\0" "ESM\0" "MSM\0");
+		if (shadowFilter == SHADOW_FILTER_VSM)
+			ImGui::SliderFloat("Light Bleed Reduction", &lightBleedReduction, 0.0f, 0.9f);
+		if (shadowFilter == SHADOW_FILTER_PCF) {
+			ImGui::Checkbox("Shadow Atlas", &useShadowAtlas);
+			if (useShadowAtlas) {
+				ImGui::SliderInt("Atlas Budget (MB)", &shadowAtlasBudgetMB, 16, 256);
+				int atlasSize = shadowAtlas.getSize();
+				ImGui::Text("Atlas %dx%d, %.1f%% used", atlasSize, atlasSize, 100.0f * shadowAtlas.getUsedTexels() / ((float)atlasSize * atlasSize));
+			}
+		}
+		ImGui::Checkbox("Point Light Shadows", &pointLightShadows);
+		ImGui::Checkbox("Cache Shadows", &cacheShadows);
+		ImGui::Text("Shadow faces rendered: %d, skipped: %d", shadowCache.getRenderedFaces(), shadowCache.getSkippedFaces());
+		ImGui::Checkbox("Time-Slice Shadows", &timeSliceShadows);
+		if (timeSliceShadows) {
+			ImGui::SliderInt("Shadow Face Budget", &shadowFaceBudget, 1, 48);
+			ImGui::Text("Faces scheduled: %d, waiting: %d", shadowScheduler.getScheduledFaces(), shadowScheduler.getDeferredFaces());
+			for (int i = 0; i < MAX_LIGHTS; i++) {
+				if (pointLights[i].isOn != 1)
+					continue;
+				int interval = shadowScheduler.getUpdateInterval(i);
+				if (interval == 0)
+					ImGui::Text("Light %d: importance %.2f, every frame, %d faces pending, %d frames stale", i, shadowScheduler.getImportance(i),
+						shadowScheduler.getPendingFaces(i), shadowScheduler.getStaleFrames(i));
+				else
+					ImGui::Text("Light %d: importance %.2f, every %d frames, %d faces pending, %d frames stale", i, shadowScheduler.getImportance(i),
+						interval, shadowScheduler.getPendingFaces(i), shadowScheduler.getStaleFrames(i));
+			}
+		}
+		ImGui::Text("Total faces skipped: %lld", shadowCache.getTotalSkippedFaces());
+		ImGui::Checkbox("Cull Shadow Faces", &cullShadowFaces);
+		ImGui::Text("Shadow triangles: %d drawn, %d culled", shadowTriangles, culledShadowTriangles);
+		ImGui::Checkbox("Cache Static Shadow Casters", &splitStaticShadows);
+		ImGui::Text("Static shadow triangles reused: %d", reusedStaticTriangles);
+		if (vertexLayerSupported)
+			ImGui::Checkbox("Vertex Shader Layer Path", &useVertexLayer);
+		else
+			ImGui::Text("Vertex shader layer not supported, using geometry shader");
+		ImGui::Checkbox("Benchmark Layer Paths", &benchmarkLayerPaths);
+		ImGui::Combo("Shadow Quality", &shadowQuality, "4 Taps\0" "8 Taps\0" "20 Taps\0" "Rotated Poisson\0");
+		ImGui::Checkbox("Adaptive Shadow Filtering", &adaptiveShadows);
+		ImGui::Text("Shadow pass (geometry shader): %.3f ms", shadowPassTimers[0].getMilliseconds());
+		if (vertexLayerSupported)
+			ImGui::Text("Shadow pass (vertex layer): %.3f ms", shadowPassTimers[1].getMilliseconds());
+		ImGui::Text("Lit pass: %.3f ms", litPassTimer.getMilliseconds());
+		ImGui::Checkbox("Screen-Space Shadow Mask", &useShadowMask);
+		if (useShadowMask) {
+			ImGui::Checkbox("Half Resolution Mask", &halfResShadowMask);
+			ImGui::Text("Prepass + shadow mask: %.3f ms", shadowMaskTimer.getMilliseconds());
+		}
+		if (projectionsAllowed) {
+			ImGui::Checkbox("Software Shadows (Selected Light)", &softwareShadowLight);
+			//Only cube faces of distances can be compared, and only while the GPU pass is drawing the light
+			bool canValidate = lightProjections[selectedLight] == SHADOW_PROJECTION_CUBE && pointLights[selectedLight].isOn && softwareLight != selectedLight;
+			if (canValidate && ImGui::Button("Validate Software Shadows"))
+				validateSoftwareShadows = true;
+			if (softwareValidated)
+				ImGui::Text("Software vs GPU: %.3f%% texels differ, max error elsewhere %.5f", softwareMismatchPercent, softwareMaxError);
+			if (ImGui::Button("Benchmark Software Shadows"))
+				benchmarkSoftwareShadows = true;
+			ImGui::Text("Software shadows: %.2f ms, %lld triangles rasterized, %d threads", softwareShadows.getMilliseconds(), softwareShadows.getTrianglesRendered(),
+				softwareShadows.getNumThreads());
+			ImGui::Text("Software benchmark: %.2f M rasterized triangles/s per thread (%d threads)", softwareBenchmarkRate / 1000000.0,
+				softwareShadows.getNumThreads());
+			ImGui::Checkbox("Benchmark Shadow Projections", &benchmarkProjections);
+			for (int i = 0; i < 3; i++) {
+				ShadowProjection projection = (ShadowProjection)i;
+				ImGui::Text("%s: %.3f ms, %d faces, %.2f texels/degree", projectionNames[i], projectionTimers[i].getMilliseconds(),
+					countCubeFaces(PointShadowMap::getProjectionFaceMask(projection)), PointShadowMap::getMinTexelsPerDegree(projection, SHADOW_WIDTH));
+			}
+		}
 		ImGui::End();
 
 		ImGui::Render();
@@ -526,6 +1231,10 @@ int main() {
 		glfwPollEvents();
 
 		glfwSwapBuffers(window);
+
+		for (SceneObject& object : sceneObjects)
+			object.transform->markClean();
+		frameCount++;
 	}
 
 	glfwTerminate();
@@ -533,36 +1242,81 @@ int main() {
 }
 
 //Author: Nicholas Tvaroha
-void drawScene(Shader &aShader) {
-	//Draw cubes
-	for (int i = 0; i < 2; i++) {
-		aShader.setMat4("_Model", cubeTransform[i].getModelMatrix());
-		cubeMesh.draw();
+void drawScene(ShaderPermutations& litShaders, unsigned int features, bool normalMap, InstanceBatches* instances) {
+	//One draw per batch, every object in it shares the mesh and the variant
+	if (instances != nullptr) {
+		for (const InstanceBatches::Batch& batch : instances->getBatches()) {
+			bool floorTextured = sceneObjects[batch.objects[0]].useTexture2;
+			litShaders.use(features | LIT_INSTANCED | (floorTextured ? LIT_FLOOR_TEXTURE : normalMap ? LIT_NORMAL_MAP : 0));
+			instances->draw(batch);
+		}
+		return;
 	}
 
-	//Draw spheres
-	for (int i = 0; i < 2; i++) {
-		aShader.setMat4("_Model", sphereTransform[i].getModelMatrix());
-		sphereMesh.draw();
+	//Cubes, spheres and cylinders first, then the floor textured planes and quads, so the variant only switches once
+	bool bound = false;
+	unsigned int boundFeatures = 0;
+	UniformHandle<glm::mat4> model;
+	UniformHandle<glm::mat3> normalMatrix;
+	for (SceneObject& object : sceneObjects) {
+		unsigned int objectFeatures = features | (object.useTexture2 ? LIT_FLOOR_TEXTURE : normalMap ? LIT_NORMAL_MAP : 0);
+		if (!bound || objectFeatures != boundFeatures) {
+			bound = true;
+			boundFeatures = objectFeatures;
+			Shader& shader = litShaders.use(objectFeatures);
+			model = shader.getUniform<glm::mat4>("_Model");
+			normalMatrix = shader.getUniform<glm::mat3>("_NormalMatrix");
+		}
+		model.set(object.transform->getModelMatrix());
+		normalMatrix.set(object.transform->getNormalMatrix());
+		object.mesh->draw();
 	}
+}
 
-	//Draw cylinders
-	for (int i = 0; i < 2; i++) {
-		aShader.setMat4("_Model", cylinderTransform[i].getModelMatrix());
-		cylinderMesh.draw();
+//Position only version of drawScene for the depth prepass
+void drawSceneDepth(Shader& aShader) {
+	UniformHandle<glm::mat4> model = aShader.getUniform<glm::mat4>("_Model");
+	for (SceneObject& object : sceneObjects) {
+		model.set(object.transform->getModelMatrix());
+		object.mesh->drawDepth();
 	}
+}
 
-	aShader.setInt("_UseTexture2", true);
-	//Draw planes
-	for (int i = 0; i < 2; i++) {
-		aShader.setMat4("_Model", planeTransform[i].getModelMatrix());
-		planeMesh.draw();
+//Shadow pass version of drawScene, each caster only goes to the cube faces in its mask
+//vertexLayer draws one instance per face instead of letting the geometry shader fan out
+void drawShadowCasters(Shader& aShader, const std::vector<int>& casterFaceMasks, bool vertexLayer, InstanceBatches* instances) {
+	if (instances != nullptr) {
+		instances->drawShadowCasters(casterFaceMasks, vertexLayer);
+		return;
 	}
-
-	//Draw quads
-	for (int i = 0; i < 4; i++) {
-		aShader.setMat4("_Model", quadTransform[i].getModelMatrix());
-		quadMesh.draw();
+	UniformHandle<glm::mat4> model = aShader.getUniform<glm::mat4>("_Model");
+	UniformHandle<int> drawLayers = aShader.getUniform<int>("_DrawLayers");
+	UniformHandle<int> faceMaskUniform = aShader.getUniform<int>("_FaceMask");
+	for (size_t i = 0; i < sceneObjects.size(); i++) {
+		const int* faceMasks = &casterFaceMasks[i * MAX_LIGHTS];
+		bool anyFaces = false;
+		for (int light = 0; light < MAX_LIGHTS; light++)
+			anyFaces |= faceMasks[light] != 0;
+		if (!anyFaces)
+			continue;
+
+		model.set(sceneObjects[i].transform->getModelMatrix());
+		if (vertexLayer) {
+			int layers[MAX_LIGHTS * 6];
+			int numLayers = 0;
+			for (int light = 0; light < MAX_LIGHTS; light++) {
+				for (int face = 0; face < 6; face++) {
+					if (faceMasks[light] & (1 << face))
+						layers[numLayers++] = light * 6 + face;
+				}
+			}
+			drawLayers.setArray(layers, numLayers);
+			sceneObjects[i].mesh->drawDepthInstanced(numLayers);
+		}
+		else {
+			faceMaskUniform.setArray(faceMasks, MAX_LIGHTS);
+			sceneObjects[i].mesh->drawDepth();
+		}
 	}
 }
 
@@ -0,0 +1,34 @@
+//Clustered lights, filled by LightClusters (Lighting/LightClusters.h) which mirrors the grid size and bindings
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+
+struct ClusterLight{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout (std430, binding = 1) readonly buffer ClusterLights {
+    ClusterLight _ClusterLights[];
+};
+// offset into _ClusterLightIndices and count, per cluster
+layout (std430, binding = 2) readonly buffer ClusterRanges {
+    uvec2 _ClusterRanges[];
+};
+layout (std430, binding = 3) readonly buffer ClusterIndices {
+    uint _ClusterLightIndices[];
+};
+
+uniform vec2 _ClusterTileSize; // screen pixels per cluster column and row
+uniform float _ClusterDepthScale;
+uniform float _ClusterDepthBias;
+uniform vec3 _CameraForward;
+
+//Lights of the cluster the fragment is in, viewDepth is its distance along the camera's forward axis
+uvec2 getClusterRange(vec2 fragCoord, float viewDepth) {
+    ivec2 tile = min(ivec2(fragCoord / _ClusterTileSize), ivec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+    int slice = clamp(int(floor(log(viewDepth) * _ClusterDepthScale + _ClusterDepthBias)), 0, CLUSTERS_Z - 1);
+    return _ClusterRanges[(slice * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x];
+}
@@ -6,29 +6,6 @@ in vec3 WorldPosition;
 in vec2 uvCoords;
 in mat3 TBN;
 
-struct PointLight{
-    float radius;
-    vec3 position;
-    float intensity;
-    vec3 color;
-    int isOn;
-};
-struct DirectionLight{
-    vec3 direction;
-    float intensity;
-    vec3 color;
-    int isOn;
-};
-struct SpotLight{
-    float radius;
-    vec3 direction;
-	float intensity;
-	vec3 color;
-	vec3 position;
-	float minAngle;
-	float maxAngle;
-	int isOn;
-};
 struct Material{
     vec3 color;
     float ambientK;
@@ -38,9 +15,7 @@ struct Material{
 };
 
 #define MAX_LIGHTS 8
-uniform PointLight _PointLights[MAX_LIGHTS];
-uniform DirectionLight _DirLight[MAX_LIGHTS];
-uniform SpotLight _SpotLight[MAX_LIGHTS];
+#include "lights.glsl"
 uniform Material _Material;
 uniform vec3 camPos;
 
@@ -51,163 +26,198 @@ uniform float _Time;
 uniform sampler2D _ObjectNormalMap;
 uniform float _NormalIntensity;
 uniform bool _UseTexture2;
-
-uniform sampler2D _ShadowMap;
-uniform samplerCube _PointShadowMap;
-uniform float _MinBias;
-uniform float _MaxBias;
-uniform float _FarPlane;
-
-float calcShadow(sampler2D shadowMap, vec4 lightSpacePos, float minBias, float maxBias, vec3 normal);
-float calcPointShadow(vec3 fragPos, vec3 normal);
+uniform bool _UseClusteredLights;
+
+#include "pointShadows.glsl"
+#include "clusters.glsl"
+
+//Screen-space shadow mask written by shadowMask.frag, one channel per light
+uniform bool _UseShadowMask;
+uniform sampler2DArray _ShadowMask;
+uniform sampler2D _SceneDistance;
+uniform int _MaskScale;
+
+void readShadowMask(out vec4 shadowMask[2]);
+
+//Variants built by ShaderPermutations (see Lighting/LitPermutations.cpp) fix the light counts and features at
+//compile time, so the loops have constant bounds and the feature branches fold away. Compiled without them, the
+//counts come from the light block and the features from the old uniforms
+#ifdef LIT_PERMUTATION
+#define POINT_LIGHT_COUNT NUM_POINT_LIGHTS
+#define DIR_LIGHT_COUNT NUM_DIR_LIGHTS
+#define SPOT_LIGHT_COUNT NUM_SPOT_LIGHTS
+#define SHADOWED (USE_SHADOWS != 0)
+#define NORMAL_MAPPED (USE_NORMAL_MAP != 0)
+#define FLOOR_TEXTURED (USE_FLOOR_TEXTURE != 0)
+#define CLUSTERED (USE_CLUSTERED_LIGHTS != 0)
+#else
+#define POINT_LIGHT_COUNT _LightCounts.x
+#define DIR_LIGHT_COUNT _LightCounts.y
+#define SPOT_LIGHT_COUNT _LightCounts.z
+#define SHADOWED true
+#define NORMAL_MAPPED (!_UseTexture2)
+#define FLOOR_TEXTURED _UseTexture2
+#define CLUSTERED _UseClusteredLights
+#endif
 
 void main(){      
     vec3 normal = normalize(WorldNormal);
     vec3 finalLight = vec3(0.0);
 
     //Calculate normal
-    if (!_UseTexture2) {
+    if (NORMAL_MAPPED) {
         normal = texture(_ObjectNormalMap, uvCoords).rgb;
         normal = normal * 2.0 - 1.0;
         normal = TBN * normal;
         normal = normalize(mix(WorldNormal, normal, _NormalIntensity));
     }
 
-    //Point Light
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        if (_PointLights[i].isOn == 1) {
-            float d = distance(_PointLights[i].position, WorldPosition);
-            float UEIntensity = clamp((1 - pow(clamp((d / _PointLights[i].radius), 0.0, 1.0), 4)), 0.0, 1.0);
-            
-            //Ambient Light
-            vec3 ambientLight = _Material.ambientK * _PointLights[i].intensity * _PointLights[i].color;
-            
-            //Diffuse Light
-            vec3 directionLight = normalize(_PointLights[i].position - WorldPosition);
-            vec3 diffuseLight = _Material.diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * _PointLights[i].intensity * _PointLights[i].color;
-            
-            //Specular Light (Blinn Phong)
-            vec3 directionCamera = normalize(camPos - WorldPosition);
-            vec3 halfVector = normalize(directionCamera + directionLight);
-            vec3 specularLight = _Material.specularK * pow(dot(normal, halfVector), _Material.shininess) * _PointLights[i].intensity * _PointLights[i].color;
-            
-            //Final light
-            float shadow = calcPointShadow(WorldPosition, normal);
+    vec4 shadowMask[2];
+    if (SHADOWED && _UseShadowMask)
+        readShadowMask(shadowMask);
 
-            finalLight += (ambientLight + (diffuseLight + specularLight) * (1.0 - shadow)) * UEIntensity;
-        }
+    //Point Light
+    for (int n = 0; n < POINT_LIGHT_COUNT; n++) {
+        int i = _PointLightIndices[n / 4][n % 4];
+        float d = distance(_PointLights[i].position, WorldPosition);
+        float UEIntensity = clamp((1 - pow(clamp((d / _PointLights[i].radius), 0.0, 1.0), 4)), 0.0, 1.0);
+        
+        //Ambient Light
+        vec3 ambientLight = _Material.ambientK * _PointLights[i].intensity * _PointLights[i].color;
+        
+        //Diffuse Light
+        vec3 directionLight = normalize(_PointLights[i].position - WorldPosition);
+        vec3 diffuseLight = _Material.diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * _PointLights[i].intensity * _PointLights[i].color;
+        
+        //Specular Light (Blinn Phong)
+        vec3 directionCamera = normalize(camPos - WorldPosition);
+        vec3 halfVector = normalize(directionCamera + directionLight);
+        vec3 specularLight = _Material.specularK * pow(dot(normal, halfVector), _Material.shininess) * _PointLights[i].intensity * _PointLights[i].color;
+        
+        //Final light
+        float shadow;
+        if (!SHADOWED)
+            shadow = 0.0;
+        else if (_UseShadowMask)
+            shadow = shadowMask[i / 4][i % 4];
+        else if (_ShadowFilter == SHADOW_FILTER_PCF)
+            shadow = calcPointShadow(WorldPosition, normal, i);
+        else if (_ShadowFilter == SHADOW_FILTER_HARDWARE_PCF)
+            shadow = calcPointShadowCompare(WorldPosition, normal, i);
+        else
+            shadow = calcPointShadowMoments(WorldPosition, normal, i);
+
+        finalLight += (ambientLight + (diffuseLight + specularLight) * (1.0 - shadow)) * UEIntensity;
     }
 
     //Directional Light
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        if (_DirLight[i].isOn == 1) {
-            //Ambient Light
-            vec3 ambientLight = _Material.ambientK * _DirLight[i].intensity * _DirLight[i].color;
-            
-            //Diffuse Light
-            vec3 directionLight = -normalize(_DirLight[i].direction);
-            vec3 diffuseLight = _Material.diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * _DirLight[i].intensity * _DirLight[i].color;
-            
-            //Specular Light (Blinn Phong)
-            vec3 directionCamera = normalize(camPos - WorldPosition);
-            vec3 halfVector = normalize(directionCamera + directionLight);
-            vec3 specularLight = _Material.specularK * pow(dot(normal, halfVector), _Material.shininess) * _DirLight[i].intensity * _DirLight[i].color;
+    for (int n = 0; n < DIR_LIGHT_COUNT; n++) {
+        int i = _DirLightIndices[n / 4][n % 4];
+        //Ambient Light
+        vec3 ambientLight = _Material.ambientK * _DirLight[i].intensity * _DirLight[i].color;
+        
+        //Diffuse Light
+        vec3 directionLight = -normalize(_DirLight[i].direction);
+        vec3 diffuseLight = _Material.diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * _DirLight[i].intensity * _DirLight[i].color;
+        
+        //Specular Light (Blinn Phong)
+        vec3 directionCamera = normalize(camPos - WorldPosition);
+        vec3 halfVector = normalize(directionCamera + directionLight);
+        vec3 specularLight = _Material.specularK * pow(dot(normal, halfVector), _Material.shininess) * _DirLight[i].intensity * _DirLight[i].color;
 
-            //Final light
-            finalLight += ambientLight + diffuseLight + specularLight;
-        }
+        //Final light
+        finalLight += ambientLight + diffuseLight + specularLight;
     }
 
     //Spot Light
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        if (_SpotLight[i].isOn == 1) {
-            //Linear Attenuation
-            float d = distance(_SpotLight[i].position, WorldPosition);
-            float UEIntensity = clamp((1 - pow((d / _SpotLight[i].radius), 4)), 0.0, 1.0);
-            
-            //Angular Attenuation
-            vec3 newDir = normalize(_SpotLight[i].direction);
-            vec3 dirToFrag = normalize((WorldPosition - _SpotLight[i].position));
-            float angle = dot(newDir, dirToFrag);
-            float maxAng = cos(radians(_SpotLight[i].maxAngle));
-            float minAng = cos(radians(_SpotLight[i].minAngle));
-            float AngIntensity = clamp(((angle - maxAng) / (minAng - maxAng)), 0.0, 1.0);
-        
-            //Ambient Light
-            vec3 ambientLight = _Material.ambientK * _SpotLight[i].intensity * _SpotLight[i].color;
-        
-            //Diffuse Light
-            vec3 directionLight = normalize(_SpotLight[i].position - WorldPosition);
-            vec3 diffuseLight = _Material.diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * _SpotLight[i].intensity * _SpotLight[i].color;
+    for (int n = 0; n < SPOT_LIGHT_COUNT; n++) {
+        int i = _SpotLightIndices[n / 4][n % 4];
+        //Linear Attenuation
+        float d = distance(_SpotLight[i].position, WorldPosition);
+        float UEIntensity = clamp((1 - pow((d / _SpotLight[i].radius), 4)), 0.0, 1.0);
         
-            //Specular Light (Blinn Phong)
-            vec3 directionCamera = normalize(camPos - WorldPosition);
+        //Angular Attenuation
+        vec3 newDir = normalize(_SpotLight[i].direction);
+        vec3 dirToFrag = normalize((WorldPosition - _SpotLight[i].position));
+        float angle = dot(newDir, dirToFrag);
+        float maxAng = cos(radians(_SpotLight[i].maxAngle));
+        float minAng = cos(radians(_SpotLight[i].minAngle));
+        float AngIntensity = clamp(((angle - maxAng) / (minAng - maxAng)), 0.0, 1.0);
+    
+        //Ambient Light
+        vec3 ambientLight = _Material.ambientK * _SpotLight[i].intensity * _SpotLight[i].color;
+    
+        //Diffuse Light
+        vec3 directionLight = normalize(_SpotLight[i].position - WorldPosition);
+        vec3 diffuseLight = _Material.diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * _SpotLight[i].intensity * _SpotLight[i].color;
+    
+        //Specular Light (Blinn Phong)
+        vec3 directionCamera = normalize(camPos - WorldPosition);
+        vec3 halfVector = normalize(directionCamera + directionLight);
+        vec3 specularLight = _Material.specularK * pow(dot(normal, halfVector), _Material.shininess) * _SpotLight[i].intensity * _SpotLight[i].color;
+    
+        //Final light
+        finalLight += (ambientLight + diffuseLight + specularLight) * AngIntensity * UEIntensity;
+    }
+
+    //Clustered lights, only the ones whose radius reaches this fragment's cluster
+    if (CLUSTERED) {
+        uvec2 range = getClusterRange(gl_FragCoord.xy, dot(WorldPosition - camPos, _CameraForward));
+        vec3 directionCamera = normalize(camPos - WorldPosition);
+        for (uint n = 0; n < range.y; n++) {
+            ClusterLight light = _ClusterLights[_ClusterLightIndices[range.x + n]];
+            float d = distance(light.position, WorldPosition);
+            float UEIntensity = clamp((1 - pow(clamp((d / light.radius), 0.0, 1.0), 4)), 0.0, 1.0);
+
+            vec3 directionLight = normalize(light.position - WorldPosition);
             vec3 halfVector = normalize(directionCamera + directionLight);
-            vec3 specularLight = _Material.specularK * pow(dot(normal, halfVector), _Material.shininess) * _SpotLight[i].intensity * _SpotLight[i].color;
-        
-            //Final light
-            finalLight += (ambientLight + diffuseLight + specularLight) * AngIntensity * UEIntensity;
+            vec3 ambientLight = _Material.ambientK * light.intensity * light.color;
+            vec3 diffuseLight = _Material.diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * light.intensity * light.color;
+            vec3 specularLight = _Material.specularK * pow(max(dot(normal, halfVector), 0.0), _Material.shininess) * light.intensity * light.color;
+            finalLight += (ambientLight + diffuseLight + specularLight) * UEIntensity;
         }
     }
 
     //Multiply final light by material color
     //finalLight *= _Material.color;
 
-    if (_UseTexture2)
+    if (FLOOR_TEXTURED)
         FragColor = texture(_FloorTexture, uvCoords) * vec4(finalLight, 1.0);
     else
         FragColor = texture(_ObjectTexture, uvCoords) * vec4(finalLight, 1.0);
 }
 
-float calcShadow(sampler2D shadowMap, vec4 lightSpacePos, float minBias, float maxBias, vec3 normal) {
-    //With Percentage Closer Filtering
-    vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w;
-    sampleCoord = sampleCoord * 0.5 + 0.5;
-    
-    float bias = max(maxBias * (1.0 - dot(normal, (lightSpacePos.xyz - WorldPosition))), minBias);
-    float myDepth = sampleCoord.z - bias;
-
-    float totalShadow = 0;
-    vec2 texelOffset = 1.0 / textureSize(shadowMap, 0);
+//Full resolution masks are read directly. Half resolution ones are upsampled bilinearly,
+//with each of the 4 texels weighted down by how far its surface is from this one
+void readShadowMask(out vec4 shadowMask[2]) {
+    ivec2 fragCoord = ivec2(gl_FragCoord.xy);
+    if (_MaskScale == 1) {
+        shadowMask[0] = texelFetch(_ShadowMask, ivec3(fragCoord, 0), 0);
+        shadowMask[1] = texelFetch(_ShadowMask, ivec3(fragCoord, 1), 0);
+        return;
+    }
 
-    for (int y = -1; y <= 1; y++) {
-        for (int x = -1; x <= 1; x++) {
-            vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
-            totalShadow += step(texture(_ShadowMap, uv).r, myDepth);
+    float fragDistance = length(WorldPosition - camPos);
+    vec2 maskPos = gl_FragCoord.xy / float(_MaskScale) - 0.5;
+    ivec2 base = ivec2(floor(maskPos));
+    vec2 f = maskPos - vec2(base);
+    ivec2 maxCoord = textureSize(_ShadowMask, 0).xy - 1;
+
+    shadowMask[0] = vec4(0.0);
+    shadowMask[1] = vec4(0.0);
+    float totalWeight = 0.0;
+    for (int y = 0; y < 2; y++) {
+        for (int x = 0; x < 2; x++) {
+            ivec2 coord = clamp(base + ivec2(x, y), ivec2(0), maxCoord);
+            float bilinear = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+            //Same full resolution pixel shadowMask.frag resolved this texel at
+            float texelDistance = texelFetch(_SceneDistance, coord * _MaskScale, 0).r;
+            float weight = bilinear / (0.001 + abs(texelDistance - fragDistance));
+            shadowMask[0] += texelFetch(_ShadowMask, ivec3(coord, 0), 0) * weight;
+            shadowMask[1] += texelFetch(_ShadowMask, ivec3(coord, 1), 0) * weight;
+            totalWeight += weight;
         }
     }
-
-    return totalShadow / 9.0f;
+    shadowMask[0] /= totalWeight;
+    shadowMask[1] /= totalWeight;
 }
-
-float calcPointShadow(vec3 fragPos, vec3 normal) {
-    float shadow = 0.0;
-    float bias   = max(_MaxBias * (1.0 - dot(normal, WorldPosition)), _MinBias);
-    int samples  = 20;
-    float viewDistance = length(camPos - fragPos);
-    float diskRadius = (1.0 + (viewDistance / _FarPlane)) / 25.0;  
-
-    //PCF
-    vec3 sampleOffsetDirections[20] = vec3[]
-    (
-       vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1), 
-       vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
-       vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
-       vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
-       vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
-    ); 
-
-    vec3 fragToLight = fragPos - _PointLights[0].position; 
-    float currentDepth = length(fragToLight);  
-
-    for(int i = 0; i < samples; ++i)
-    {
-        float closestDepth = texture(_PointShadowMap, fragToLight + sampleOffsetDirections[i] * diskRadius).r;
-        closestDepth *= _FarPlane;   // undo mapping [0;1]
-        if(currentDepth - bias > closestDepth)
-            shadow += 1.0;
-    }
-    shadow /= float(samples);  
-
-    return shadow;
-}
\ No newline at end of file
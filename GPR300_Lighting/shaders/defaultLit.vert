@@ -4,7 +4,25 @@ layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec2 vUv;
 layout (location = 3) in vec3 vTangent;
 
+//Instanced variants (see Lighting/InstanceBatches.h) read the matrices per instance instead of per draw
+#ifdef LIT_PERMUTATION
+#define INSTANCED (USE_INSTANCING != 0)
+#else
+#define INSTANCED 0
+#endif
+
+#if INSTANCED
+layout (location = 4) in mat4 vModel;
+layout (location = 8) in mat3 vNormalMatrix;
+#define MODEL_MATRIX vModel
+#define NORMAL_MATRIX vNormalMatrix
+#else
 uniform mat4 _Model;
+//Inverse transpose of mat3(_Model), computed once per object on the CPU
+uniform mat3 _NormalMatrix;
+#define MODEL_MATRIX _Model
+#define NORMAL_MATRIX _NormalMatrix
+#endif
 uniform mat4 _View;
 uniform mat4 _Projection;
 
@@ -12,10 +30,12 @@ out vec3 WorldNormal;
 out vec3 WorldPosition;
 out vec2 uvCoords;
 out mat3 TBN;
+//Same depth as depthPrepass.vert, the lit pass can run with GL_EQUAL after a prepass
+invariant gl_Position;
 
 void main(){    
-    WorldPosition = vec3(_Model * vec4(vPos,1));
-    WorldNormal = transpose(inverse(mat3(_Model))) * vNormal;
+    WorldPosition = vec3(MODEL_MATRIX * vec4(vPos,1));
+    WorldNormal = NORMAL_MATRIX * vNormal;
     uvCoords = vUv;
     //Calculating TBN
     vec3 vBiTangent = cross(vNormal, vTangent);
@@ -23,6 +43,6 @@ void main(){
 		vTangent.x, vTangent.y, vTangent.z,
 	    vBiTangent.x, vBiTangent.y, vBiTangent.z,
 		vNormal.x, vNormal.y, vNormal.z );
-    TBN = transpose(inverse(mat3(_Model))) * TBN;
-    gl_Position = _Projection * _View * _Model * vec4(vPos,1);
+    TBN = NORMAL_MATRIX * TBN;
+    gl_Position = _Projection * _View * MODEL_MATRIX * vec4(vPos,1);
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#version 450
+//Lighting pass of the deferred path, drawn over the whole screen with postLit.vert.
+//Each pixel is shaded once, by the directional lights and the lights tileLightCulling.comp listed for its tile
+out vec4 FragColor;
+
+#define MAX_LIGHTS 8
+#include "lights.glsl"
+uniform vec3 camPos;
+
+#include "pointShadows.glsl"
+#include "clusters.glsl"
+#include "gBuffer.glsl"
+#include "tileLights.glsl"
+
+uniform sampler2D _GBufferNormal;
+uniform sampler2D _GBufferAlbedo;
+uniform sampler2D _GBufferMaterial;
+uniform sampler2D _GBufferDepth;
+uniform mat4 _InverseViewProjection;
+uniform bool _UsePointShadows;
+
+void main(){
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(_GBufferDepth, 0);
+    float depth = texelFetch(_GBufferDepth, pixel, 0).r;
+    //Background keeps the clear color
+    if (depth >= 1.0)
+        discard;
+
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(size) * 2.0 - 1.0;
+    vec4 world = _InverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec3 WorldPosition = world.xyz / world.w;
+    vec3 normal = decodeOctahedral(texelFetch(_GBufferNormal, pixel, 0).rg);
+    vec4 albedo = texelFetch(_GBufferAlbedo, pixel, 0);
+    vec4 material = texelFetch(_GBufferMaterial, pixel, 0);
+    float ambientK = material.r;
+    float diffuseK = material.g;
+    float specularK = material.b;
+    float shininess = material.a * MAX_SHININESS;
+
+    vec3 directionCamera = normalize(camPos - WorldPosition);
+    vec3 finalLight = vec3(0.0);
+
+    //Directional lights reach every pixel and are never culled
+    for (int n = 0; n < _LightCounts.y; n++) {
+        int i = _DirLightIndices[n / 4][n % 4];
+        vec3 ambientLight = ambientK * _DirLight[i].intensity * _DirLight[i].color;
+        vec3 directionLight = -normalize(_DirLight[i].direction);
+        vec3 diffuseLight = diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * _DirLight[i].intensity * _DirLight[i].color;
+        vec3 halfVector = normalize(directionCamera + directionLight);
+        vec3 specularLight = specularK * pow(max(dot(normal, halfVector), 0.0), shininess) * _DirLight[i].intensity * _DirLight[i].color;
+        finalLight += ambientLight + diffuseLight + specularLight;
+    }
+
+    ivec2 tile = pixel / TILE_SIZE;
+    int numTilesX = (size.x + TILE_SIZE - 1) / TILE_SIZE;
+    uint tileBase = uint(tile.y * numTilesX + tile.x) * TILE_STRIDE;
+    uint count = _TileLights[tileBase];
+    for (uint n = 0; n < count; n++) {
+        uint reference = _TileLights[tileBase + 1 + n];
+        uint kind = reference >> 30;
+        int i = int(reference & TILE_LIGHT_INDEX_MASK);
+
+        vec3 position;
+        float radius, intensity, attenuation = 1.0;
+        vec3 color;
+        if (kind == TILE_POINT_LIGHT) {
+            position = _PointLights[i].position;
+            radius = _PointLights[i].radius;
+            color = _PointLights[i].color;
+            intensity = _PointLights[i].intensity;
+        }
+        else if (kind == TILE_SPOT_LIGHT) {
+            position = _SpotLight[i].position;
+            radius = _SpotLight[i].radius;
+            color = _SpotLight[i].color;
+            intensity = _SpotLight[i].intensity;
+            //Angular Attenuation
+            float angle = dot(normalize(_SpotLight[i].direction), normalize(WorldPosition - position));
+            float maxAng = cos(radians(_SpotLight[i].maxAngle));
+            float minAng = cos(radians(_SpotLight[i].minAngle));
+            attenuation = clamp(((angle - maxAng) / (minAng - maxAng)), 0.0, 1.0);
+        }
+        else {
+            position = _ClusterLights[i].position;
+            radius = _ClusterLights[i].radius;
+            color = _ClusterLights[i].color;
+            intensity = _ClusterLights[i].intensity;
+        }
+
+        float d = distance(position, WorldPosition);
+        float UEIntensity = clamp((1 - pow(clamp((d / radius), 0.0, 1.0), 4)), 0.0, 1.0);
+        vec3 ambientLight = ambientK * intensity * color;
+        vec3 directionLight = normalize(position - WorldPosition);
+        vec3 diffuseLight = diffuseK * (clamp(dot(directionLight, normal), 0.0f, 100.0f)) * intensity * color;
+        vec3 halfVector = normalize(directionCamera + directionLight);
+        vec3 specularLight = specularK * pow(max(dot(normal, halfVector), 0.0), shininess) * intensity * color;
+
+        //Only the eight uniform block point lights have shadow maps
+        float shadow = 0.0;
+        if (kind == TILE_POINT_LIGHT && _UsePointShadows) {
+            if (_ShadowFilter == SHADOW_FILTER_PCF)
+                shadow = calcPointShadow(WorldPosition, normal, i);
+            else if (_ShadowFilter == SHADOW_FILTER_HARDWARE_PCF)
+                shadow = calcPointShadowCompare(WorldPosition, normal, i);
+            else
+                shadow = calcPointShadowMoments(WorldPosition, normal, i);
+        }
+        finalLight += (ambientLight + (diffuseLight + specularLight) * (1.0 - shadow)) * UEIntensity * attenuation;
+    }
+
+    FragColor = albedo * vec4(finalLight, 1.0);
+}
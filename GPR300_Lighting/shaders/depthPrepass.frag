@@ -0,0 +1,11 @@
+#version 450
+in vec3 WorldPosition;
+
+uniform vec3 camPos;
+
+//Distance from the camera, rebuilds positions far more precisely than the depth buffer would
+out float FragDistance;
+
+void main(){
+    FragDistance = length(WorldPosition - camPos);
+}
@@ -0,0 +1,15 @@
+#version 450
+layout (location = 0) in vec3 vPos;
+
+uniform mat4 _Model;
+uniform mat4 _View;
+uniform mat4 _Projection;
+
+out vec3 WorldPosition;
+//Must match defaultLit.vert bit for bit for the lit pass's GL_EQUAL test
+invariant gl_Position;
+
+void main(){
+    WorldPosition = vec3(_Model * vec4(vPos,1));
+    gl_Position = _Projection * _View * _Model * vec4(vPos,1);
+}
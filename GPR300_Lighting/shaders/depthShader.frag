@@ -1,20 +1,23 @@
 //Code Provide by OpenGL
 //https://learnopengl.com/Advanced-Lighting/Shadows/Point-Shadows
 
-#version 330 core
+#version 450 core
+#define MAX_LIGHTS 8
+
 in vec4 FragPos;
+flat in int LightIndex;
 
-uniform vec3 lightPos;
-uniform float far_plane;
+uniform vec3 lightPos[MAX_LIGHTS];
+uniform float far_plane[MAX_LIGHTS]; // fitted to each light's radius
 
 void main()
 {
     // get distance between fragment and light source
-    float lightDistance = length(FragPos.xyz - lightPos);
+    float lightDistance = length(FragPos.xyz - lightPos[LightIndex]);
     
     // map to [0;1] range by dividing by far_plane
-    lightDistance = lightDistance / far_plane;
+    lightDistance = lightDistance / far_plane[LightIndex];
     
     // write this as modified depth
     gl_FragDepth = lightDistance;
-}  
\ No newline at end of file
+}  
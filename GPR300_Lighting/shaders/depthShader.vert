@@ -4,9 +4,24 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+#ifdef INSTANCED
+// per instance, see Lighting/InstanceBatches.h
+layout (location = 1) in mat4 aModel;
+layout (location = 5) in ivec4 aFaceMasksLow; // lights 0-3
+layout (location = 6) in ivec4 aFaceMasksHigh; // lights 4-7
+flat out ivec4 FaceMasksLow;
+flat out ivec4 FaceMasksHigh;
+#else
 uniform mat4 _Model;
+#endif
 
 void main()
 {
+#ifdef INSTANCED
+    FaceMasksLow = aFaceMasksLow;
+    FaceMasksHigh = aFaceMasksHigh;
+    gl_Position = aModel * vec4(aPos, 1.0);
+#else
     gl_Position = _Model * vec4(aPos, 1.0);
+#endif
 } 
\ No newline at end of file
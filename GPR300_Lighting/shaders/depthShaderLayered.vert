@@ -0,0 +1,58 @@
+//Geometry shader free version of depthShader.vert + depthShader.geom
+//Each instance renders the mesh into one cube face, chosen by writing gl_Layer from the vertex shader
+
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#define MAX_LIGHTS 8
+
+layout (location = 0) in vec3 aPos;
+
+#ifdef INSTANCED
+// per instance, see Lighting/InstanceBatches.h: one instance per caster and cube array layer
+layout (location = 1) in mat4 aModel;
+layout (location = 7) in int aLayer;
+#else
+uniform mat4 _Model;
+uniform int _DrawLayers[MAX_LIGHTS * 6]; // per draw: cube array layer (light * 6 + face) for each instance
+#endif
+uniform mat4 _ShadowMatrices[MAX_LIGHTS * 6];
+uniform int _ShadowProjection[MAX_LIGHTS]; // ShadowProjection in PointShadowMap.h
+uniform vec3 lightPos[MAX_LIGHTS];
+uniform float far_plane[MAX_LIGHTS]; // fitted to each light's radius
+
+out vec4 FragPos;
+flat out int LightIndex;
+out float gl_ClipDistance[1];
+
+#define SHADOW_PROJECTION_DUAL_PARABOLOID 2
+
+void main()
+{
+#ifdef INSTANCED
+    int layer = aLayer;
+    mat4 model = aModel;
+#else
+    int layer = _DrawLayers[gl_InstanceID];
+    mat4 model = _Model;
+#endif
+    gl_Layer = layer;
+    LightIndex = layer / 6;
+    FragPos = model * vec4(aPos, 1.0);
+    if (_ShadowProjection[LightIndex] == SHADOW_PROJECTION_DUAL_PARABOLOID)
+    {
+        // same hemisphere mapping as depthShader.geom
+        vec3 toVertex = FragPos.xyz - lightPos[LightIndex];
+        float dist = length(toVertex);
+        vec3 dir = toVertex / dist;
+        if (layer % 6 == 1)
+            dir.xz = -dir.xz;
+        gl_ClipDistance[0] = -dir.z;
+        gl_Position = vec4(dir.xy / max(1.0 - dir.z, 1e-4), dist / far_plane[LightIndex] * 2.0 - 1.0, 1.0);
+    }
+    else
+    {
+        gl_ClipDistance[0] = 1.0;
+        gl_Position = _ShadowMatrices[layer] * FragPos;
+    }
+}
@@ -0,0 +1,44 @@
+#version 450 core
+#define MAX_LIGHTS 8
+
+//Matches ShadowFilter in PointShadowMap.h
+#define SHADOW_FILTER_VSM 2
+#define SHADOW_FILTER_ESM 3
+#define SHADOW_FILTER_MSM 4
+#define ESM_EXPONENT 80.0
+
+in vec4 FragPos;
+flat in int LightIndex;
+
+uniform vec3 lightPos[MAX_LIGHTS];
+uniform float far_plane[MAX_LIGHTS]; // fitted to each light's radius
+uniform int _ShadowFilter;
+
+out vec4 FragMoments;
+
+void main()
+{
+    // same [0;1] light distance depthShader.frag writes, stored as moments so it can be filtered
+    float depth = length(FragPos.xyz - lightPos[LightIndex]) / far_plane[LightIndex];
+
+    if (_ShadowFilter == SHADOW_FILTER_ESM) {
+        FragMoments = vec4(exp(ESM_EXPONENT * depth), 0.0, 0.0, 0.0);
+    }
+    else if (_ShadowFilter == SHADOW_FILTER_MSM) {
+        // 4 moments, rotated so they survive 16 bit float storage (Peters & Klein 2015)
+        float square = depth * depth;
+        vec4 moments = vec4(depth, square, square * depth, square * square);
+        FragMoments = mat4(
+            -2.07224649, 13.7948857237, 0.105877704, 9.7924062118,
+            32.23703778, -59.4683975703, -1.9077466311, -33.7652110555,
+            -68.571074599, 82.0359750338, 9.3496555107, 47.9456096605,
+            39.3703274134, -35.364903257, -6.6543490743, -23.9728048165) * moments;
+        FragMoments.x += 0.035955884801;
+    }
+    else {
+        // VSM, slope based term keeps the variance from collapsing on surfaces at an angle to the light
+        float dx = dFdx(depth);
+        float dy = dFdy(depth);
+        FragMoments = vec4(depth, depth * depth + 0.25 * (dx * dx + dy * dy), 0.0, 0.0);
+    }
+}
@@ -0,0 +1,52 @@
+#version 450
+//Geometry pass of the deferred path, same inputs and feature variants as defaultLit.frag but no lighting
+layout (location = 0) out vec2 GNormal;
+layout (location = 1) out vec4 GAlbedo;
+layout (location = 2) out vec4 GMaterial;
+
+in vec3 WorldNormal;
+in vec3 WorldPosition;
+in vec2 uvCoords;
+in mat3 TBN;
+
+struct Material{
+    vec3 color;
+    float ambientK;
+    float diffuseK;
+    float specularK;
+    float shininess;
+};
+uniform Material _Material;
+
+uniform sampler2D _FloorTexture;
+uniform sampler2D _ObjectTexture;
+uniform sampler2D _ObjectNormalMap;
+uniform float _NormalIntensity;
+uniform bool _UseTexture2;
+
+#include "gBuffer.glsl"
+
+#ifdef LIT_PERMUTATION
+#define NORMAL_MAPPED (USE_NORMAL_MAP != 0)
+#define FLOOR_TEXTURED (USE_FLOOR_TEXTURE != 0)
+#else
+#define NORMAL_MAPPED (!_UseTexture2)
+#define FLOOR_TEXTURED _UseTexture2
+#endif
+
+void main(){
+    vec3 normal = normalize(WorldNormal);
+    if (NORMAL_MAPPED) {
+        normal = texture(_ObjectNormalMap, uvCoords).rgb;
+        normal = normal * 2.0 - 1.0;
+        normal = TBN * normal;
+        normal = normalize(mix(WorldNormal, normal, _NormalIntensity));
+    }
+    GNormal = encodeOctahedral(normal);
+
+    if (FLOOR_TEXTURED)
+        GAlbedo = texture(_FloorTexture, uvCoords);
+    else
+        GAlbedo = texture(_ObjectTexture, uvCoords);
+    GMaterial = vec4(_Material.ambientK, _Material.diffuseK, _Material.specularK, _Material.shininess / MAX_SHININESS);
+}
@@ -0,0 +1,18 @@
+//G-buffer layout shared by gBuffer.frag and deferredLit.frag, allocated by GBuffer (Lighting/GBuffer.h)
+//0: RG16F octahedral world normal, 1: RGBA8 albedo, 2: RGBA8 ambientK, diffuseK, specularK, shininess / MAX_SHININESS
+#define MAX_SHININESS 256.0
+
+//Unit vector to the [-1, 1] square: the octahedron |x| + |y| + |z| = 1 is unfolded onto it
+vec2 encodeOctahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : folded;
+}
+
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
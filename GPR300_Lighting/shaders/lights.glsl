@@ -0,0 +1,35 @@
+//Every light in one std140 uniform block, mirrored by LightBlock in Lighting/LightBuffer.h.
+//Members are ordered so each vec3 shares its 16 bytes with a scalar. The including shader defines MAX_LIGHTS first
+struct PointLight{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+    int isOn;
+};
+struct DirectionLight{
+    vec3 direction;
+    float intensity;
+    vec3 color;
+    int isOn;
+};
+struct SpotLight{
+    vec3 position;
+    float radius;
+    vec3 direction;
+    float intensity;
+    vec3 color;
+    float minAngle;
+    float maxAngle;
+    int isOn;
+};
+
+layout (std140, binding = 0) uniform Lights {
+    PointLight _PointLights[MAX_LIGHTS];
+    DirectionLight _DirLight[MAX_LIGHTS];
+    SpotLight _SpotLight[MAX_LIGHTS];
+    ivec4 _LightCounts; // lights switched on: point, directional, spot
+    ivec4 _PointLightIndices[MAX_LIGHTS / 4]; // their indices, 4 to an ivec4
+    ivec4 _DirLightIndices[MAX_LIGHTS / 4];
+    ivec4 _SpotLightIndices[MAX_LIGHTS / 4];
+};
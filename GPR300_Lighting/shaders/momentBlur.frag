@@ -0,0 +1,24 @@
+#version 450
+out vec4 FragColor;
+
+//One direction of a separable 9 tap gaussian over a single cube face
+uniform sampler2DArray _Source;
+uniform int _Layer;
+uniform vec2 _Direction;
+
+const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+
+void main() {
+    ivec2 size = textureSize(_Source, 0).xy;
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 step = ivec2(_Direction);
+
+    vec4 result = texelFetch(_Source, ivec3(texel, _Layer), 0) * weights[0];
+    for (int i = 1; i < 5; i++) {
+        ivec2 a = clamp(texel + step * i, ivec2(0), size - 1);
+        ivec2 b = clamp(texel - step * i, ivec2(0), size - 1);
+        result += texelFetch(_Source, ivec3(a, _Layer), 0) * weights[i];
+        result += texelFetch(_Source, ivec3(b, _Layer), 0) * weights[i];
+    }
+    FragColor = result;
+}
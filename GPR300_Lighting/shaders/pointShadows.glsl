@@ -0,0 +1,245 @@
+//Point light shadow lookups and filters, shared by defaultLit.frag and shadowMask.frag
+//The including shader declares MAX_LIGHTS, _PointLights and camPos first
+
+uniform samplerCubeArray _PointShadowMap;
+uniform float _MinBias;
+uniform float _MaxBias;
+uniform float _ShadowNearPlanes[MAX_LIGHTS]; // fitted to the closest caster
+uniform float _ShadowFarPlanes[MAX_LIGHTS]; // fitted to the light's radius
+uniform samplerCubeArrayShadow _PointShadowCompareMap;
+uniform samplerCubeArray _PointMomentMap;
+uniform float _LightBleedReduction;
+uniform sampler2D _ShadowAtlas;
+uniform bool _UseShadowAtlas;
+uniform vec4 _AtlasRects[MAX_LIGHTS * 6];
+uniform sampler2DArray _PointShadowLayers;
+
+//Matches ShadowProjection in PointShadowMap.h, chosen per light
+#define SHADOW_PROJECTION_CUBE 0
+#define SHADOW_PROJECTION_TETRAHEDRON 1
+#define SHADOW_PROJECTION_DUAL_PARABOLOID 2
+uniform int _ShadowProjection[MAX_LIGHTS];
+uniform mat4 _TetrahedronMatrices[4]; // face view projections for a light at the origin
+
+//Same order as TETRAHEDRON_NORMALS in PointShadowMap.cpp
+const vec3 tetrahedronNormals[4] = vec3[]
+(
+   vec3( 1,  1,  1), vec3( 1, -1, -1), vec3(-1,  1, -1), vec3(-1, -1,  1)
+);
+
+//Matches ShadowFilter in PointShadowMap.h
+#define SHADOW_FILTER_PCF 0
+#define SHADOW_FILTER_HARDWARE_PCF 1
+#define SHADOW_FILTER_VSM 2
+#define SHADOW_FILTER_ESM 3
+#define SHADOW_FILTER_MSM 4
+#define ESM_EXPONENT 80.0
+uniform int _ShadowFilter;
+
+//Point shadow PCF quality tiers, set from main.cpp
+#define SHADOW_QUALITY_4 0
+#define SHADOW_QUALITY_8 1
+#define SHADOW_QUALITY_20 2
+#define SHADOW_QUALITY_POISSON 3
+uniform int _ShadowQuality;
+uniform bool _AdaptiveShadows;
+
+//Ordered so the first 4 (a tetrahedron) and first 8 (cube corners) are each evenly spread
+const vec3 sampleOffsetDirections[20] = vec3[]
+(
+   vec3( 1,  1,  1), vec3( 1, -1, -1), vec3(-1,  1, -1), vec3(-1, -1,  1),
+   vec3(-1, -1, -1), vec3(-1,  1,  1), vec3( 1, -1,  1), vec3( 1,  1, -1),
+   vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
+   vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
+   vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
+);
+
+//First 4 points cover the disk on their own so they work as the adaptive probe
+const vec2 poissonDisk[16] = vec2[]
+(
+   vec2(-0.6474, -0.5730), vec2( 0.6842,  0.5973), vec2( 0.5826, -0.6612), vec2(-0.5906,  0.6437),
+   vec2(-0.0943, -0.9295), vec2( 0.9213, -0.0602), vec2(-0.9406,  0.0211), vec2( 0.0478,  0.9358),
+   vec2(-0.2518, -0.2064), vec2( 0.2687,  0.1743), vec2( 0.1822, -0.3216), vec2(-0.1996,  0.3394),
+   vec2(-0.4835, -0.0587), vec2( 0.4569, -0.0411), vec2( 0.3011, -0.8022), vec2(-0.3241,  0.7617)
+);
+
+//Stored [0;1] distance towards dir, from the light's cube, tetrahedron or paraboloids, or from its faces' rects in the atlas
+float pointShadowDistance(vec3 dir, int lightIndex) {
+    if (_ShadowProjection[lightIndex] == SHADOW_PROJECTION_TETRAHEDRON) {
+        int face = 0;
+        float best = dot(dir, tetrahedronNormals[0]);
+        for (int i = 1; i < 4; i++) {
+            float d = dot(dir, tetrahedronNormals[i]);
+            if (d > best) {
+                best = d;
+                face = i;
+            }
+        }
+        vec4 clipPos = _TetrahedronMatrices[face] * vec4(dir, 1.0);
+        vec2 uv = clipPos.xy / clipPos.w * 0.5 + 0.5;
+        return texture(_PointShadowLayers, vec3(uv, lightIndex * 6 + face)).r;
+    }
+    if (_ShadowProjection[lightIndex] == SHADOW_PROJECTION_DUAL_PARABOLOID) {
+        vec3 d = normalize(dir);
+        int face = d.z <= 0.0 ? 0 : 1;
+        if (face == 1)
+            d.xz = -d.xz;
+        vec2 uv = d.xy / (1.0 - d.z) * 0.5 + 0.5;
+        return texture(_PointShadowLayers, vec3(uv, lightIndex * 6 + face)).r;
+    }
+    if (!_UseShadowAtlas)
+        return texture(_PointShadowMap, vec4(dir, lightIndex)).r;
+
+    //Cube face selection from the GL spec, same orientation the face matrices render with
+    vec3 a = abs(dir);
+    int face;
+    vec2 st;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = dir.x > 0.0 ? 0 : 1;
+        st = vec2(dir.x > 0.0 ? -dir.z : dir.z, -dir.y) / a.x;
+    }
+    else if (a.y >= a.z) {
+        face = dir.y > 0.0 ? 2 : 3;
+        st = vec2(dir.x, dir.y > 0.0 ? dir.z : -dir.z) / a.y;
+    }
+    else {
+        face = dir.z > 0.0 ? 4 : 5;
+        st = vec2(dir.z > 0.0 ? dir.x : -dir.x, -dir.y) / a.z;
+    }
+    vec4 rect = _AtlasRects[lightIndex * 6 + face];
+    vec2 halfTexel = 0.5 / vec2(textureSize(_ShadowAtlas, 0));
+    vec2 uv = clamp(rect.xy + (st * 0.5 + 0.5) * rect.zw, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+    return texture(_ShadowAtlas, uv).r;
+}
+
+float calcPointShadow(vec3 fragPos, vec3 normal, int lightIndex) {
+    float shadow = 0.0;
+    float bias   = max(_MaxBias * (1.0 - dot(normal, fragPos)), _MinBias);
+    float farPlane = _ShadowFarPlanes[lightIndex];
+    bool poisson = _ShadowQuality == SHADOW_QUALITY_POISSON;
+    int samples  = _ShadowQuality == SHADOW_QUALITY_4 ? 4 : _ShadowQuality == SHADOW_QUALITY_8 ? 8 : poisson ? 16 : 20;
+    float viewDistance = length(camPos - fragPos);
+    float diskRadius = (1.0 + (viewDistance / farPlane)) / 25.0;  
+
+    vec3 fragToLight = fragPos - _PointLights[lightIndex].position; 
+    float currentDepth = length(fragToLight);  
+
+    //Poisson disk lies on the plane facing the light, rotated per pixel to turn banding into noise
+    vec3 tangent = vec3(0.0);
+    vec3 bitangent = vec3(0.0);
+    if (poisson) {
+        vec3 n = fragToLight / currentDepth;
+        vec3 up = abs(n.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+        float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+        vec3 t = normalize(cross(up, n));
+        vec3 b = cross(n, t);
+        tangent = (t * cos(angle) + b * sin(angle)) * 1.5;
+        bitangent = (b * cos(angle) - t * sin(angle)) * 1.5;
+    }
+
+    //PCF
+    for(int i = 0; i < samples; ++i)
+    {
+        vec3 offset = poisson ? tangent * poissonDisk[i].x + bitangent * poissonDisk[i].y : sampleOffsetDirections[i];
+        float closestDepth = pointShadowDistance(fragToLight + offset * diskRadius, lightIndex);
+        closestDepth *= farPlane;   // undo mapping [0;1]
+        if(currentDepth - bias > closestDepth)
+            shadow += 1.0;
+
+        //If the first taps all agree we are outside the penumbra and the rest would agree too
+        if (_AdaptiveShadows && i == 3 && (shadow == 0.0 || shadow == 4.0))
+            return shadow / 4.0;
+    }
+    shadow /= float(samples);  
+
+    return shadow;
+}
+
+//Shadow map holds projected depth instead of distance, every tap is a hardware 2x2 PCF compare
+float calcPointShadowCompare(vec3 fragPos, vec3 normal, int lightIndex) {
+    float bias   = max(_MaxBias * (1.0 - dot(normal, fragPos)), _MinBias);
+    float nearPlane = _ShadowNearPlanes[lightIndex];
+    float farPlane = _ShadowFarPlanes[lightIndex];
+    float viewDistance = length(camPos - fragPos);
+    float diskRadius = (1.0 + (viewDistance / farPlane)) / 25.0;
+
+    vec3 fragToLight = fragPos - _PointLights[lightIndex].position;
+    float currentDepth = length(fragToLight) - bias;
+
+    //Bilinear compares already soften the edge, so the tetrahedral first 4 offsets are enough
+    float lit = 0.0;
+    for(int i = 0; i < 4; ++i)
+    {
+        vec3 sampleDir = fragToLight + sampleOffsetDirections[i] * diskRadius;
+        //Depth along the major axis of the face this tap lands on, then the same projection the shadow pass used
+        vec3 absDir = abs(sampleDir);
+        float faceDepth = max(absDir.x, max(absDir.y, absDir.z)) * currentDepth / length(sampleDir);
+        float ndcDepth = (farPlane + nearPlane) / (farPlane - nearPlane) - (2.0 * farPlane * nearPlane) / ((farPlane - nearPlane) * faceDepth);
+        lit += texture(_PointShadowCompareMap, vec4(sampleDir, lightIndex), ndcDepth * 0.5 + 0.5);
+    }
+
+    return 1.0 - lit / 4.0;
+}
+
+//4 moment Hamburger reconstruction (Peters & Klein 2015), returns the shadowed fraction
+float calcMSMShadow(vec4 optimizedMoments, float depth) {
+    optimizedMoments.x -= 0.035955884801;
+    vec4 b = mat4(
+        0.2227744146, 0.1549679261, 0.1451988946, 0.163127443,
+        0.0771972861, 0.1394629426, 0.2120202157, 0.2591432266,
+        0.7926986636, 0.7963415838, 0.7258694464, 0.6539092497,
+        0.0319417555, -0.1722823173, -0.2758014811, -0.3376131734) * optimizedMoments;
+    b = mix(b, vec4(0.5), 6e-5);
+
+    vec3 z;
+    z.x = depth;
+    float L32D22 = -b.x * b.y + b.z;
+    float D22 = -b.x * b.x + b.y;
+    float squaredDepthVariance = -b.y * b.y + b.w;
+    float D33D22 = dot(vec2(squaredDepthVariance, -L32D22), vec2(D22, L32D22));
+    float invD22 = 1.0 / D22;
+    float L32 = L32D22 * invD22;
+
+    vec3 c = vec3(1.0, z.x, z.x * z.x);
+    c.y -= b.x;
+    c.z -= b.y + L32 * c.y;
+    c.y *= invD22;
+    c.z *= D22 / D33D22;
+    c.y -= L32 * c.z;
+    c.x -= dot(c.yz, b.xy);
+
+    float p = c.y / c.z;
+    float q = c.x / c.z;
+    float r = sqrt(max(p * p * 0.25 - q, 0.0));
+    z.y = -p * 0.5 - r;
+    z.z = -p * 0.5 + r;
+
+    vec4 switchVal = (z.z < z.x) ? vec4(z.y, z.x, 1.0, 1.0) :
+                     (z.y < z.x) ? vec4(z.x, z.y, 0.0, 1.0) : vec4(0.0);
+    float quotient = (switchVal.x * z.z - b.x * (switchVal.x + z.z) + b.y) / ((z.z - switchVal.y) * (z.x - z.y));
+    return clamp(switchVal.z + switchVal.w * quotient, 0.0, 1.0);
+}
+
+//Prefiltered moment shadows, one trilinear fetch replaces the PCF loop
+float calcPointShadowMoments(vec3 fragPos, vec3 normal, int lightIndex) {
+    float bias = max(_MaxBias * (1.0 - dot(normal, fragPos)), _MinBias);
+    vec3 fragToLight = fragPos - _PointLights[lightIndex].position;
+    float depth = (length(fragToLight) - bias) / _ShadowFarPlanes[lightIndex];
+    vec4 moments = texture(_PointMomentMap, vec4(fragToLight, lightIndex));
+
+    if (_ShadowFilter == SHADOW_FILTER_ESM) {
+        return 1.0 - clamp(exp(-ESM_EXPONENT * depth) * moments.x, 0.0, 1.0);
+    }
+    if (_ShadowFilter == SHADOW_FILTER_MSM) {
+        return calcMSMShadow(moments, depth);
+    }
+
+    //VSM: Chebyshev upper bound, remapped to cut off the light bleeding tail
+    if (depth <= moments.x)
+        return 0.0;
+    float variance = max(moments.y - moments.x * moments.x, 0.00002);
+    float d = depth - moments.x;
+    float pMax = variance / (variance + d * d);
+    pMax = clamp((pMax - _LightBleedReduction) / (1.0 - _LightBleedReduction), 0.0, 1.0);
+    return 1.0 - pMax;
+}
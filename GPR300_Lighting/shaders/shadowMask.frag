@@ -0,0 +1,44 @@
+#version 450
+//Resolves every point light's shadow once per visible pixel, after the depth prepass
+//Lights 0-3 go to layer 0 of the mask, 4-7 to layer 1
+layout (location = 0) out vec4 Mask0;
+layout (location = 1) out vec4 Mask1;
+
+#define MAX_LIGHTS 8
+#include "lights.glsl"
+uniform vec3 camPos;
+
+#include "pointShadows.glsl"
+
+uniform sampler2D _SceneDistance;
+uniform mat4 _InverseViewProjection;
+uniform int _MaskScale; // full resolution pixels per mask pixel
+
+void main(){
+    //A half resolution mask pixel stands for the top left full resolution pixel it covers
+    ivec2 fullSize = textureSize(_SceneDistance, 0);
+    ivec2 fullCoord = min(ivec2(gl_FragCoord.xy) * _MaskScale, fullSize - 1);
+    float dist = texelFetch(_SceneDistance, fullCoord, 0).r;
+
+    vec2 ndc = (vec2(fullCoord) + 0.5) / vec2(fullSize) * 2.0 - 1.0;
+    vec4 farPoint = _InverseViewProjection * vec4(ndc, 1.0, 1.0);
+    vec3 rayDir = normalize(farPoint.xyz / farPoint.w - camPos);
+    vec3 fragPos = camPos + rayDir * dist;
+    vec3 normal = normalize(cross(dFdx(fragPos), dFdy(fragPos)));
+
+    float shadows[MAX_LIGHTS];
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        shadows[i] = 0.0;
+        //Background was cleared to 0
+        if (dist <= 0.0 || _PointLights[i].isOn != 1)
+            continue;
+        if (_ShadowFilter == SHADOW_FILTER_PCF)
+            shadows[i] = calcPointShadow(fragPos, normal, i);
+        else if (_ShadowFilter == SHADOW_FILTER_HARDWARE_PCF)
+            shadows[i] = calcPointShadowCompare(fragPos, normal, i);
+        else
+            shadows[i] = calcPointShadowMoments(fragPos, normal, i);
+    }
+    Mask0 = vec4(shadows[0], shadows[1], shadows[2], shadows[3]);
+    Mask1 = vec4(shadows[4], shadows[5], shadows[6], shadows[7]);
+}
@@ -0,0 +1,15 @@
+//Per tile light lists, written by tileLightCulling.comp and read by deferredLit.frag.
+//Each tile has TILE_STRIDE uints: the count, then up to MAX_TILE_LIGHTS references
+#define TILE_SIZE 16
+#define MAX_TILE_LIGHTS 255
+#define TILE_STRIDE (MAX_TILE_LIGHTS + 1)
+
+//A reference is the light's kind in the top 2 bits and its index below
+#define TILE_POINT_LIGHT 0u
+#define TILE_SPOT_LIGHT 1u
+#define TILE_CLUSTER_LIGHT 2u
+#define TILE_LIGHT_INDEX_MASK 0x3FFFFFFFu
+
+layout (std430, binding = 4) buffer TileLights {
+    uint _TileLights[];
+};